@@ -0,0 +1,80 @@
+// Copyright (c) 2015 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// The profiler calls into the AMX API, which is normally provided by the
+// server. The benchmark has no VM, so these are implemented here just
+// enough for SyntheticAMX.
+
+#include <amx/amx.h>
+#include <amxprof/amx_utils.h>
+#include "synthetic_amx.h"
+
+uint16_t * AMXAPI amx_Align16(uint16_t *v) {
+  return v;
+}
+
+uint32_t * AMXAPI amx_Align32(uint32_t *v) {
+  return v;
+}
+
+#if defined _I64_MAX || defined HAVE_I64
+uint64_t * AMXAPI amx_Align64(uint64_t *v) {
+  return v;
+}
+#endif
+
+int AMXAPI amx_Flags(AMX *amx, uint16_t *flags) {
+  *flags = reinterpret_cast<AMX_HEADER*>(amx->base)->flags;
+  return AMX_ERR_NONE;
+}
+
+int AMXAPI amx_NumNatives(AMX *amx, int *number) {
+  AMX_HEADER *hdr = reinterpret_cast<AMX_HEADER*>(amx->base);
+  *number = (hdr->libraries - hdr->natives) / hdr->defsize;
+  return AMX_ERR_NONE;
+}
+
+int AMXAPI amx_NumPublics(AMX *amx, int *number) {
+  AMX_HEADER *hdr = reinterpret_cast<AMX_HEADER*>(amx->base);
+  *number = (hdr->natives - hdr->publics) / hdr->defsize;
+  return AMX_ERR_NONE;
+}
+
+int AMXAPI amx_Callback(AMX *amx, cell index, cell *result, cell *params) {
+  return SyntheticAMX::Callback(amx, index, result, params);
+}
+
+int AMXAPI amx_Exec(AMX *amx, cell *retval, int index) {
+  if ((amx->flags & AMX_FLAG_BROWSE) != 0) {
+    // Opcodes in the synthetic code are not relocated, so the "relocation
+    // table" is just the identity.
+    static cell opcode_table[amxprof::NUM_OPCODES];
+    for (int i = 0; i < amxprof::NUM_OPCODES; i++) {
+      opcode_table[i] = i;
+    }
+    *reinterpret_cast<cell**>(retval) = opcode_table;
+    return AMX_ERR_NONE;
+  }
+  return SyntheticAMX::Exec(amx, retval, index);
+}
@@ -0,0 +1,276 @@
+// Copyright (c) 2015 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// Measures the overhead that the profiler's hooks add to each function
+// call by running a synthetic script with and without instrumentation.
+// Results are printed as JSON so they can be compared between versions.
+//
+// Usage: amxprof_bench [--depth N] [--fanout N] [--recursion 0|1]
+//                      [--native-ratio X] [--natives N] [--call-graph 0|1]
+//                      [--iterations N] [--record events.bin] [--async 0|1]
+//                      [--sample-interval N]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <amxprof/async_profiler.h>
+#include <amxprof/clock.h>
+#include <amxprof/event_recorder.h>
+#include <amxprof/profiler.h>
+#include "cache_miss_counter.h"
+#include "synthetic_amx.h"
+
+namespace {
+
+long num_allocations = 0;
+
+struct Options {
+  Options()
+   : call_graph(false),
+     async(false),
+     sample_interval(0),
+     iterations(1000),
+     warmup_iterations(10)
+  {
+  }
+
+  WorkloadOptions workload;
+  bool call_graph;
+  bool async;
+  long sample_interval;
+  long iterations;
+  long warmup_iterations;
+  std::string record_filename;
+};
+
+struct Result {
+  double ns_per_call;
+  double allocations_per_call;
+  double cache_misses_per_call;
+};
+
+void PrintUsage(const char *program) {
+  std::fprintf(stderr,
+    "Usage: %s [--depth N] [--fanout N] [--recursion 0|1]\n"
+    "          [--native-ratio X] [--natives N] [--call-graph 0|1]\n"
+    "          [--iterations N] [--record events.bin] [--async 0|1]\n"
+    "          [--sample-interval N]\n",
+    program);
+}
+
+bool ParseOptions(int argc, char **argv, Options &options) {
+  for (int i = 1; i < argc; i++) {
+    if (i + 1 >= argc) {
+      return false;
+    }
+    const char *name = argv[i];
+    const char *value = argv[++i];
+    if (std::strcmp(name, "--depth") == 0) {
+      options.workload.depth = std::atoi(value);
+    } else if (std::strcmp(name, "--fanout") == 0) {
+      options.workload.fanout = std::atoi(value);
+    } else if (std::strcmp(name, "--recursion") == 0) {
+      options.workload.recursion = std::atoi(value) != 0;
+    } else if (std::strcmp(name, "--native-ratio") == 0) {
+      options.workload.native_ratio = std::atof(value);
+    } else if (std::strcmp(name, "--natives") == 0) {
+      options.workload.num_natives = std::atoi(value);
+    } else if (std::strcmp(name, "--call-graph") == 0) {
+      options.call_graph = std::atoi(value) != 0;
+    } else if (std::strcmp(name, "--iterations") == 0) {
+      options.iterations = std::atol(value);
+    } else if (std::strcmp(name, "--async") == 0) {
+      options.async = std::atoi(value) != 0;
+    } else if (std::strcmp(name, "--sample-interval") == 0) {
+      options.sample_interval = std::atol(value);
+    } else if (std::strcmp(name, "--record") == 0) {
+      options.record_filename = value;
+    } else {
+      return false;
+    }
+  }
+  return options.iterations > 0;
+}
+
+// Runs the public function of the synthetic script the given number of
+// times, through the profiler if there is one.
+void Run(SyntheticAMX &script,
+         amxprof::Profiler *profiler,
+         amxprof::AsyncProfiler *async_profiler,
+         long iterations) {
+  cell retval;
+  for (long i = 0; i < iterations; i++) {
+    if (async_profiler != 0) {
+      async_profiler->ExecHook(&retval, script.main_index());
+    } else if (profiler != 0) {
+      profiler->ExecHook(&retval, script.main_index());
+    } else {
+      amx_Exec(script.amx(), &retval, script.main_index());
+    }
+  }
+}
+
+// Only the time spent in the AMX thread is measured, in async mode the
+// aggregator thread may still be busy when this returns.
+Result Measure(SyntheticAMX &script,
+               amxprof::Profiler *profiler,
+               amxprof::AsyncProfiler *async_profiler,
+               const Options &options) {
+  script.set_profiler(profiler);
+  script.set_async_profiler(async_profiler);
+  Run(script, profiler, async_profiler, options.warmup_iterations);
+
+  CacheMissCounter cache_misses;
+  long allocations_before = num_allocations;
+  amxprof::TimePoint start = amxprof::Clock::Now();
+  cache_misses.Start();
+
+  Run(script, profiler, async_profiler, options.iterations);
+
+  amxprof::uint64_t num_cache_misses = cache_misses.Stop();
+  amxprof::Nanoseconds time = amxprof::Clock::Now() - start;
+  long allocations = num_allocations - allocations_before;
+
+  double num_calls =
+    static_cast<double>(script.calls_per_run()) * options.iterations;
+
+  Result result;
+  result.ns_per_call = time.count() / num_calls;
+  result.allocations_per_call = allocations / num_calls;
+  result.cache_misses_per_call = cache_misses.is_available()
+    ? num_cache_misses / num_calls
+    : -1;
+  return result;
+}
+
+void PrintResult(const char *name, const Result &result, bool last) {
+  std::printf("  \"%s\": {\n", name);
+  std::printf("    \"ns_per_call\": %.3f,\n", result.ns_per_call);
+  std::printf("    \"allocations_per_call\": %.6f,\n",
+              result.allocations_per_call);
+  if (result.cache_misses_per_call >= 0) {
+    std::printf("    \"cache_misses_per_call\": %.6f\n",
+                result.cache_misses_per_call);
+  } else {
+    std::printf("    \"cache_misses_per_call\": null\n");
+  }
+  std::printf("  }%s\n", last ? "" : ",");
+}
+
+} // anonymous namespace
+
+void *operator new(std::size_t size) {
+  num_allocations++;
+  void *ptr = std::malloc(size != 0 ? size : 1);
+  if (ptr == 0) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void *operator new[](std::size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void *ptr) throw() {
+  std::free(ptr);
+}
+
+void operator delete[](void *ptr) throw() {
+  std::free(ptr);
+}
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!ParseOptions(argc, argv, options)) {
+    PrintUsage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  SyntheticAMX script(options.workload);
+  Result baseline = Measure(script, 0, 0, options);
+
+  amxprof::Profiler profiler(script.amx(), options.call_graph);
+  profiler.Allocate();
+  profiler.EnableSampling(options.sample_interval,
+                          options.warmup_iterations,
+                          amxprof::Microseconds(1));
+  Result profiled;
+  if (options.async) {
+    amxprof::AsyncProfiler async_profiler(script.amx(), &profiler);
+    async_profiler.Start();
+    profiled = Measure(script, 0, &async_profiler, options);
+    async_profiler.Stop();
+  } else {
+    profiled = Measure(script, &profiler, 0, options);
+  }
+
+  // Recording is much slower than profiling, so it's done separately.
+  if (!options.record_filename.empty()) {
+    amxprof::EventRecorder recorder;
+    if (!recorder.Open(options.record_filename)) {
+      std::fprintf(stderr, "Error opening %s\n",
+                   options.record_filename.c_str());
+      return EXIT_FAILURE;
+    }
+    amxprof::Profiler recording_profiler(script.amx(), options.call_graph);
+    recording_profiler.Allocate();
+    recording_profiler.set_event_recorder(&recorder);
+    script.set_profiler(&recording_profiler);
+    script.set_async_profiler(0);
+    Run(script, &recording_profiler, 0, options.iterations);
+  }
+
+  // Each call is one enter and one leave.
+  Result overhead;
+  overhead.ns_per_call = profiled.ns_per_call - baseline.ns_per_call;
+  overhead.allocations_per_call =
+    profiled.allocations_per_call - baseline.allocations_per_call;
+  overhead.cache_misses_per_call = profiled.cache_misses_per_call >= 0
+    ? profiled.cache_misses_per_call - baseline.cache_misses_per_call
+    : -1;
+
+  const WorkloadOptions &workload = options.workload;
+  std::printf("{\n");
+  std::printf("  \"workload\": {\n");
+  std::printf("    \"depth\": %d,\n", workload.depth);
+  std::printf("    \"fanout\": %d,\n", workload.fanout);
+  std::printf("    \"recursion\": %s,\n", workload.recursion ? "true" : "false");
+  std::printf("    \"native_ratio\": %.3f,\n", workload.native_ratio);
+  std::printf("    \"natives\": %d,\n", workload.num_natives);
+  std::printf("    \"call_graph\": %s,\n", options.call_graph ? "true" : "false");
+  std::printf("    \"async\": %s,\n", options.async ? "true" : "false");
+  std::printf("    \"sample_interval\": %ld\n", options.sample_interval);
+  std::printf("  },\n");
+  std::printf("  \"iterations\": %ld,\n", options.iterations);
+  std::printf("  \"calls_per_iteration\": %ld,\n", script.calls_per_run());
+  PrintResult("baseline", baseline, false);
+  PrintResult("profiled", profiled, false);
+  PrintResult("overhead", overhead, true);
+  std::printf("}\n");
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,118 @@
+// Copyright (c) 2015 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// Replays events recorded with profiler_recordevents (or amxprof_bench
+// --record) through the profiler and reports how long processing them
+// takes. Because the recorded times are used, every replay produces the
+// same statistics, so changes to the profiler's data structures can be
+// benchmarked and checked for correctness against a real workload.
+//
+// Usage: amxprof_replay [--iterations N] [--call-graph 0|1]
+//                       [--output stats.txt] events.bin
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <amxprof/clock.h>
+#include <amxprof/event_replayer.h>
+#include <amxprof/profiler.h>
+#include <amxprof/statistics_writer_text.h>
+
+int main(int argc, char **argv) {
+  long iterations = 10;
+  bool call_graph = false;
+  std::string output_filename;
+  std::string events_filename;
+
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+      iterations = std::atol(argv[++i]);
+    } else if (std::strcmp(argv[i], "--call-graph") == 0 && i + 1 < argc) {
+      call_graph = std::atoi(argv[++i]) != 0;
+    } else if (std::strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+      output_filename = argv[++i];
+    } else if (argv[i][0] != '-' && events_filename.empty()) {
+      events_filename = argv[i];
+    } else {
+      events_filename.clear();
+      break;
+    }
+  }
+  if (events_filename.empty() || iterations <= 0) {
+    std::fprintf(stderr,
+      "Usage: %s [--iterations N] [--call-graph 0|1]\n"
+      "          [--output stats.txt] events.bin\n",
+      argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  amxprof::EventReplayer replayer;
+  if (!replayer.Open(events_filename)) {
+    std::fprintf(stderr, "Error opening %s\n", events_filename.c_str());
+    return EXIT_FAILURE;
+  }
+
+  double total_ns = 0;
+  for (long i = 0; i < iterations; i++) {
+    amxprof::Profiler profiler(0, call_graph);
+    profiler.Allocate();
+
+    amxprof::TimePoint start = amxprof::Clock::Now();
+    bool ok = replayer.Replay(&profiler);
+    total_ns += (amxprof::Clock::Now() - start).count();
+
+    if (!ok) {
+      std::fprintf(stderr, "Error in %s after %lu events\n",
+                   events_filename.c_str(),
+                   static_cast<unsigned long>(replayer.num_events()));
+      return EXIT_FAILURE;
+    }
+
+    if (i + 1 == iterations && !output_filename.empty()) {
+      std::ofstream stream(output_filename.c_str());
+      profiler.SymbolizeFunctions();
+      amxprof::StatisticsWriterText writer;
+      writer.set_stream(&stream);
+      writer.set_script_name(events_filename);
+      writer.set_print_date(false);
+      writer.set_print_run_time(false);
+      writer.Write(profiler.stats());
+    }
+  }
+
+  double num_events = static_cast<double>(replayer.num_events());
+  std::printf("{\n");
+  std::printf("  \"events\": %lu,\n",
+              static_cast<unsigned long>(replayer.num_events()));
+  std::printf("  \"iterations\": %ld,\n", iterations);
+  std::printf("  \"call_graph\": %s,\n", call_graph ? "true" : "false");
+  std::printf("  \"ns_per_replay\": %.0f,\n", total_ns / iterations);
+  std::printf("  \"ns_per_event\": %.3f\n",
+              num_events > 0 ? total_ns / iterations / num_events : 0.0);
+  std::printf("}\n");
+
+  return EXIT_SUCCESS;
+}
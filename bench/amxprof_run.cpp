@@ -0,0 +1,198 @@
+// Copyright (c) 2015 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// Runs compiled scripts on a real AMX interpreter with and without the
+// profiler and reports how much slower each profiling mode is. Unlike
+// amxprof_bench this includes the cost of the VM itself, so the numbers
+// are closer to what a server would see, but they depend on the VM and
+// compiler it was built with (neither is part of this repository).
+//
+// Usage: amxprof_run [--iterations N] file.amx [file.amx ...]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <amx/amx.h>
+#include <amx/amxaux.h>
+#include <amxprof/clock.h>
+#include <amxprof/profiler.h>
+
+namespace {
+
+enum Mode {
+  MODE_NONE,
+  MODE_HOOKS,
+  MODE_PROFILE,
+  MODE_PROFILE_CALL_GRAPH,
+  NUM_MODES
+};
+
+const char *const kModeNames[NUM_MODES] = {
+  "none",
+  "hooks",
+  "profile",
+  "profile_call_graph"
+};
+
+// There is only one script running at a time.
+amxprof::Profiler *profiler = 0;
+
+cell AMX_NATIVE_CALL bench_noop(AMX *amx, cell *params) {
+  (void)amx;
+  return params[1];
+}
+
+cell AMX_NATIVE_CALL bench_add(AMX *amx, cell *params) {
+  (void)amx;
+  return params[1] + params[2];
+}
+
+const AMX_NATIVE_INFO natives[] = {
+  {"bench_noop", bench_noop},
+  {"bench_add",  bench_add},
+  {0,            0}
+};
+
+// Hooks installed in MODE_HOOKS only forward to the VM, so comparing that
+// mode with MODE_NONE shows the cost of having hooks at all.
+int AMXAPI DebugHook(AMX *amx) {
+  if (profiler != 0) {
+    return profiler->DebugHook();
+  }
+  (void)amx;
+  return AMX_ERR_NONE;
+}
+
+int AMXAPI CallbackHook(AMX *amx, cell index, cell *result, cell *params) {
+  if (profiler != 0) {
+    return profiler->CallbackHook(index, result, params, amx_Callback);
+  }
+  return amx_Callback(amx, index, result, params);
+}
+
+int Exec(AMX *amx, cell *retval) {
+  if (profiler != 0) {
+    return profiler->ExecHook(retval, AMX_EXEC_MAIN, amx_Exec);
+  }
+  return amx_Exec(amx, retval, AMX_EXEC_MAIN);
+}
+
+// Returns the average time of one run of main() in nanoseconds or -1 on
+// error.
+double Measure(const std::string &filename, Mode mode, long iterations) {
+  AMX amx;
+  int error = aux_LoadProgram(&amx, filename.c_str(), 0);
+  if (error != AMX_ERR_NONE) {
+    std::fprintf(stderr, "Error loading %s: %s\n",
+                 filename.c_str(), aux_StrError(error));
+    return -1;
+  }
+
+  amx_Register(&amx, natives, -1);
+  if (mode != MODE_NONE) {
+    amx_SetDebugHook(&amx, DebugHook);
+    amx_SetCallback(&amx, CallbackHook);
+  }
+  if (mode == MODE_PROFILE || mode == MODE_PROFILE_CALL_GRAPH) {
+    profiler = new amxprof::Profiler(&amx, mode == MODE_PROFILE_CALL_GRAPH);
+    profiler->Allocate();
+  }
+
+  // Warm up.
+  cell retval;
+  error = Exec(&amx, &retval);
+
+  amxprof::TimePoint start = amxprof::Clock::Now();
+  for (long i = 0; i < iterations && error == AMX_ERR_NONE; i++) {
+    error = Exec(&amx, &retval);
+  }
+  amxprof::Nanoseconds time = amxprof::Clock::Now() - start;
+
+  delete profiler;
+  profiler = 0;
+  aux_FreeProgram(&amx);
+
+  if (error != AMX_ERR_NONE) {
+    std::fprintf(stderr, "Error running %s: %s\n",
+                 filename.c_str(), aux_StrError(error));
+    return -1;
+  }
+  return static_cast<double>(time.count()) / iterations;
+}
+
+} // anonymous namespace
+
+int main(int argc, char **argv) {
+  long iterations = 100;
+  std::vector<std::string> filenames;
+
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+      iterations = std::atol(argv[++i]);
+    } else if (argv[i][0] != '-') {
+      filenames.push_back(argv[i]);
+    } else {
+      filenames.clear();
+      break;
+    }
+  }
+  if (filenames.empty() || iterations <= 0) {
+    std::fprintf(stderr, "Usage: %s [--iterations N] file.amx [...]\n",
+                 argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  int status = EXIT_SUCCESS;
+
+  std::printf("{\n");
+  std::printf("  \"iterations\": %ld,\n", iterations);
+  std::printf("  \"scripts\": {\n");
+
+  for (std::size_t i = 0; i < filenames.size(); i++) {
+    double times[NUM_MODES];
+    for (int mode = 0; mode < NUM_MODES; mode++) {
+      times[mode] = Measure(filenames[i], static_cast<Mode>(mode), iterations);
+      if (times[mode] < 0) {
+        status = EXIT_FAILURE;
+      }
+    }
+
+    std::printf("    \"%s\": {\n", filenames[i].c_str());
+    for (int mode = 0; mode < NUM_MODES; mode++) {
+      double slowdown = times[MODE_NONE] > 0 ? times[mode] / times[MODE_NONE]
+                                             : 0;
+      std::printf("      \"%s\": {\"ns_per_run\": %.0f, \"slowdown\": %.3f}%s\n",
+                  kModeNames[mode], times[mode], slowdown,
+                  mode + 1 < NUM_MODES ? "," : "");
+    }
+    std::printf("    }%s\n", i + 1 < filenames.size() ? "," : "");
+  }
+
+  std::printf("  }\n");
+  std::printf("}\n");
+
+  return status;
+}
@@ -0,0 +1,324 @@
+// Copyright (c) 2015 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <cassert>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <amxprof/amx_utils.h>
+#include <amxprof/async_profiler.h>
+#include <amxprof/profiler.h>
+#include "synthetic_amx.h"
+
+namespace {
+
+const long kSyntheticTag = 0x53594e54; // 'SYNT'
+
+// Native addresses are pointers in a real server. Pick values that can't
+// collide with code offsets.
+const ucell kNativeAddressBase = 0x7f000000;
+
+// Code of every function: PROC, BREAK, CALL <target>, BREAK, RETN. The
+// call site's return address is that of the second BREAK.
+enum {
+  kFunctionSize = 6,
+  kCallOperandOffset = 3,
+  kReturnAddressOffset = 4
+};
+
+std::size_t CellsFor(std::size_t bytes) {
+  return (bytes + sizeof(cell) - 1) / sizeof(cell);
+}
+
+} // anonymous namespace
+
+SyntheticAMX::SyntheticAMX(const WorkloadOptions &options)
+ : options_(options),
+   profiler_(0),
+   async_profiler_(0),
+   native_acc_(0),
+   next_native_(0),
+   calls_per_run_(0)
+{
+  if (options_.depth < 1) {
+    options_.depth = 1;
+  }
+  if (options_.fanout < 1) {
+    options_.fanout = 1;
+  }
+  if (options_.num_natives < 1) {
+    options_.num_natives = 1;
+  }
+  BuildImage();
+
+  // Do a dry run to count calls.
+  cell retval;
+  Exec(&amx_, &retval, main_index());
+}
+
+void SyntheticAMX::BuildImage() {
+  // Function 0 is the public, the rest are ordinary functions called at
+  // each level (or just one if they all recurse into the same function).
+  int num_functions = options_.recursion ? 2 : options_.depth + 1;
+
+  std::vector<std::string> names;
+  names.push_back("OnBench");
+  for (int i = 0; i < options_.num_natives; i++) {
+    char name[32];
+    std::sprintf(name, "bench_native%d", i);
+    names.push_back(name);
+  }
+
+  std::size_t names_size = sizeof(uint16_t);
+  for (std::size_t i = 0; i < names.size(); i++) {
+    names_size += names[i].length() + 1;
+  }
+
+  std::size_t header_cells = CellsFor(sizeof(AMX_HEADER));
+  std::size_t publics_cells = CellsFor(sizeof(AMX_FUNCSTUBNT));
+  std::size_t natives_cells =
+    CellsFor(sizeof(AMX_FUNCSTUBNT) * options_.num_natives);
+  std::size_t names_cells = CellsFor(names_size);
+  std::size_t code_cells = 1 + num_functions * kFunctionSize;
+  std::size_t stack_cells = (options_.depth + 16) * 8;
+
+  std::size_t publics = header_cells;
+  std::size_t natives = publics + publics_cells;
+  std::size_t nametable = natives + natives_cells;
+  std::size_t cod = nametable + names_cells;
+  std::size_t dat = cod + code_cells;
+  std::size_t end = dat + stack_cells;
+
+  image_.assign(end, 0);
+  unsigned char *base = reinterpret_cast<unsigned char*>(&image_[0]);
+
+  AMX_HEADER *hdr = reinterpret_cast<AMX_HEADER*>(base);
+  hdr->size = static_cast<int32_t>(dat * sizeof(cell));
+  hdr->magic = AMX_MAGIC;
+  hdr->file_version = CUR_FILE_VERSION;
+  hdr->amx_version = MIN_AMX_VERSION;
+  hdr->flags = AMX_FLAG_NTVREG | AMX_FLAG_RELOC;
+  hdr->defsize = sizeof(AMX_FUNCSTUBNT);
+  hdr->cod = static_cast<int32_t>(cod * sizeof(cell));
+  hdr->dat = static_cast<int32_t>(dat * sizeof(cell));
+  hdr->hea = static_cast<int32_t>(end * sizeof(cell));
+  hdr->stp = static_cast<int32_t>(end * sizeof(cell));
+  hdr->cip = -1;
+  hdr->publics = static_cast<int32_t>(publics * sizeof(cell));
+  hdr->natives = static_cast<int32_t>(natives * sizeof(cell));
+  hdr->libraries = static_cast<int32_t>(nametable * sizeof(cell));
+  hdr->pubvars = hdr->libraries;
+  hdr->tags = hdr->libraries;
+  hdr->nametable = hdr->libraries;
+
+  unsigned char *name = base + hdr->nametable + sizeof(uint16_t);
+  std::vector<uint32_t> name_offsets;
+  for (std::size_t i = 0; i < names.size(); i++) {
+    name_offsets.push_back(static_cast<uint32_t>(name - base));
+    std::memcpy(name, names[i].c_str(), names[i].length() + 1);
+    name += names[i].length() + 1;
+  }
+
+  cell *code = &image_[cod];
+  code[0] = amxprof::OP_HALT;
+
+  for (int i = 0; i < num_functions; i++) {
+    cell start = 1 + i * kFunctionSize;
+    function_addresses_.push_back(start * sizeof(cell));
+    return_addresses_.push_back((start + kReturnAddressOffset) * sizeof(cell));
+  }
+  for (int i = 0; i < num_functions; i++) {
+    cell *function = code + 1 + i * kFunctionSize;
+    int callee = (options_.recursion && i > 0) ? i : i + 1;
+    function[0] = amxprof::OP_PROC;
+    function[1] = amxprof::OP_BREAK;
+    function[2] = amxprof::OP_CALL;
+    function[4] = amxprof::OP_BREAK;
+    function[5] = amxprof::OP_RETN;
+    if (callee < num_functions) {
+      // After relocation call targets are absolute addresses.
+      unsigned char *target =
+        reinterpret_cast<unsigned char*>(code) + function_addresses_[callee];
+      function[kCallOperandOffset] =
+        static_cast<cell>(reinterpret_cast<std::size_t>(target));
+    } else {
+      function[2] = amxprof::OP_NOP;
+      function[3] = amxprof::OP_NOP;
+    }
+  }
+
+  AMX_FUNCSTUBNT *public_table =
+    reinterpret_cast<AMX_FUNCSTUBNT*>(base + hdr->publics);
+  public_table[0].address = function_addresses_[0];
+  public_table[0].nameofs = name_offsets[0];
+
+  AMX_FUNCSTUBNT *native_table =
+    reinterpret_cast<AMX_FUNCSTUBNT*>(base + hdr->natives);
+  for (int i = 0; i < options_.num_natives; i++) {
+    native_table[i].address = kNativeAddressBase + i * sizeof(cell);
+    native_table[i].nameofs = name_offsets[i + 1];
+  }
+
+  std::memset(&amx_, 0, sizeof(amx_));
+  amx_.base = base;
+  amx_.stp = static_cast<cell>(stack_cells * sizeof(cell));
+  amx_.stk = amx_.stp;
+  amx_.flags = AMX_FLAG_NTVREG | AMX_FLAG_RELOC;
+  amx_.usertags[0] = kSyntheticTag;
+  amx_.userdata[0] = this;
+}
+
+// static
+SyntheticAMX *SyntheticAMX::FromAMX(AMX *amx) {
+  if (amx->usertags[0] != kSyntheticTag) {
+    return 0;
+  }
+  return static_cast<SyntheticAMX*>(amx->userdata[0]);
+}
+
+// static
+int SyntheticAMX::Exec(AMX *amx, cell *retval, int index) {
+  SyntheticAMX *self = FromAMX(amx);
+  if (self == 0 || index != self->main_index()) {
+    return AMX_ERR_INDEX;
+  }
+
+  self->native_acc_ = 0;
+  self->next_native_ = 0;
+  self->calls_per_run_ = 0;
+
+  // amx_Exec() pushes the argument size and a zero return address, and
+  // the public's PROC does the rest.
+  self->Push(0);
+  self->Push(0);
+  self->RunFunction(0);
+  self->Pop();
+  self->Pop();
+
+  *retval = 1;
+  return AMX_ERR_NONE;
+}
+
+// static
+int SyntheticAMX::Callback(AMX *amx, cell index, cell *result, cell *params) {
+  SyntheticAMX *self = FromAMX(amx);
+  if (self == 0 || index < 0 || index >= self->options_.num_natives) {
+    return AMX_ERR_NOTFOUND;
+  }
+  *result = params[1];
+  return AMX_ERR_NONE;
+}
+
+void SyntheticAMX::RunFunction(int level) {
+  // PROC
+  Push(amx_.frm);
+  amx_.frm = amx_.stk;
+  Break();
+
+  if (level < options_.depth) {
+    for (int i = 0; i < options_.fanout; i++) {
+      native_acc_ += options_.native_ratio;
+      if (native_acc_ >= 1.0) {
+        native_acc_ -= 1.0;
+        CallNative(level, next_native_);
+        next_native_ = (next_native_ + 1) % options_.num_natives;
+      } else {
+        CallFunction(level + 1);
+      }
+    }
+  }
+
+  // RETN (minus popping the return address and arguments, which is done
+  // by the caller)
+  amx_.stk = amx_.frm;
+  amx_.frm = Pop();
+}
+
+void SyntheticAMX::CallFunction(int level) {
+  int caller = (options_.recursion && level > 1) ? 1 : level - 1;
+  calls_per_run_++;
+
+  Push(0);
+  Push(return_addresses_[caller]);
+  RunFunction(level);
+  Pop();
+  Pop();
+
+  // Execution resumes at the BREAK after the call.
+  Break();
+}
+
+void SyntheticAMX::CallNative(int level, cell index) {
+  calls_per_run_++;
+
+  // Natives are called in place of the CALL instruction, and the VM points
+  // CIP past the instruction like for SYSREQ.C.
+  int caller = (options_.recursion && level > 0) ? 1 : level;
+  amx_.cip = return_addresses_[caller];
+
+  cell params[2];
+  params[0] = sizeof(cell);
+  params[1] = index;
+
+  cell result;
+  if (async_profiler_ != 0) {
+    async_profiler_->CallbackHook(index, &result, params);
+  } else if (profiler_ != 0) {
+    profiler_->CallbackHook(index, &result, params);
+  } else {
+    ::amx_Callback(&amx_, index, &result, params);
+  }
+}
+
+void SyntheticAMX::Break() {
+  if (async_profiler_ != 0) {
+    async_profiler_->DebugHook();
+  } else if (profiler_ != 0) {
+    profiler_->DebugHook();
+  }
+}
+
+cell SyntheticAMX::ReadData(cell offset) const {
+  const AMX_HEADER *hdr = reinterpret_cast<const AMX_HEADER*>(amx_.base);
+  assert(offset >= 0 && offset < amx_.stp);
+  return *reinterpret_cast<const cell*>(amx_.base + hdr->dat + offset);
+}
+
+void SyntheticAMX::WriteData(cell offset, cell value) {
+  const AMX_HEADER *hdr = reinterpret_cast<const AMX_HEADER*>(amx_.base);
+  assert(offset >= 0 && offset < amx_.stp);
+  *reinterpret_cast<cell*>(amx_.base + hdr->dat + offset) = value;
+}
+
+void SyntheticAMX::Push(cell value) {
+  amx_.stk -= sizeof(cell);
+  WriteData(amx_.stk, value);
+}
+
+cell SyntheticAMX::Pop() {
+  cell value = ReadData(amx_.stk);
+  amx_.stk += sizeof(cell);
+  return value;
+}
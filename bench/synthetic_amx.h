@@ -0,0 +1,121 @@
+// Copyright (c) 2015 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef SYNTHETIC_AMX_H
+#define SYNTHETIC_AMX_H
+
+#include <vector>
+#include <amx/amx.h>
+
+namespace amxprof {
+class AsyncProfiler;
+class Profiler;
+}
+
+struct WorkloadOptions {
+  WorkloadOptions()
+   : depth(8),
+     fanout(2),
+     recursion(false),
+     native_ratio(0.25),
+     num_natives(4)
+  {
+  }
+
+  // How deep the call tree below the public function goes.
+  int depth;
+  // How many calls each function makes to the next level.
+  int fanout;
+  // Call one self-recursive function at every level instead of a separate
+  // function per level.
+  bool recursion;
+  // Fraction of calls (0..1) that go to natives instead of functions.
+  double native_ratio;
+  int num_natives;
+};
+
+// An AMX image built in memory that contains just enough of the header,
+// function tables and code for the profiler to work with, and an
+// interpreter that simulates what the VM would do when running it: it
+// maintains the stack frames and calls the debug hook and natives through
+// the profiler exactly where real code would. Nothing is executed except
+// the bookkeeping, so the cost measured is mostly that of the profiler.
+class SyntheticAMX {
+ public:
+  explicit SyntheticAMX(const WorkloadOptions &options);
+
+  AMX *amx() { return &amx_; }
+
+  // The public function that runs the whole call tree.
+  int main_index() const { return 0; }
+
+  // If set, calls are routed through the profiler's hooks; otherwise the
+  // same workload runs without instrumentation.
+  void set_profiler(amxprof::Profiler *profiler) {
+    profiler_ = profiler;
+  }
+  void set_async_profiler(amxprof::AsyncProfiler *profiler) {
+    async_profiler_ = profiler;
+  }
+
+  // Number of non-public calls (functions and natives) made by one run of
+  // the public function, for computing per-call figures.
+  long calls_per_run() const { return calls_per_run_; }
+
+  static SyntheticAMX *FromAMX(AMX *amx);
+
+  // Implementations of amx_Exec() and amx_Callback() for synthetic AMXes.
+  static int Exec(AMX *amx, cell *retval, int index);
+  static int Callback(AMX *amx, cell index, cell *result, cell *params);
+
+ private:
+  void BuildImage();
+  void RunFunction(int level);
+  void CallFunction(int level);
+  void CallNative(int level, cell index);
+  void Break();
+
+  cell ReadData(cell offset) const;
+  void WriteData(cell offset, cell value);
+  void Push(cell value);
+  cell Pop();
+
+ private:
+  WorkloadOptions options_;
+  std::vector<cell> image_;
+  std::vector<cell> function_addresses_;
+  std::vector<cell> return_addresses_;
+  AMX amx_;
+  amxprof::Profiler *profiler_;
+  amxprof::AsyncProfiler *async_profiler_;
+  double native_acc_;
+  cell next_native_;
+  long calls_per_run_;
+
+ private:
+  SyntheticAMX(const SyntheticAMX &other);
+  SyntheticAMX &operator=(const SyntheticAMX &other);
+};
+
+#endif // !SYNTHETIC_AMX_H
@@ -28,6 +28,10 @@
 #include <map>
 #include <amx/amx.h>
 
+// Associates an object of type T with each AMX instance. T must define
+// kUserDataTag, the AMX user data tag under which the handler is stored
+// (see amx_SetUserData()). If all user data slots are taken, the handler
+// is only kept in a map, which is slower to search.
 template<typename T>
 class AMXHandler {
  public:
@@ -56,12 +60,19 @@ template<typename T>
 T *AMXHandler<T>::CreateHandler(AMX *amx) {
   T *handler = new T(amx);
   handlers_.insert(std::make_pair(amx, handler));
+  amx_SetUserData(amx, T::kUserDataTag, handler);
   return handler;
 }
 
 // static
 template<typename T>
 T *AMXHandler<T>::GetHandler(AMX *amx) {
+  // This is called from every hook, so avoid going through amx_GetUserData().
+  for (int i = 0; i < AMX_USERNUM; i++) {
+    if (amx->usertags[i] == T::kUserDataTag && amx->userdata[i] != 0) {
+      return static_cast<T*>(amx->userdata[i]);
+    }
+  }
   typename HandlerMap::const_iterator iterator = handlers_.find(amx);
   if (iterator != handlers_.end()) {
     return iterator->second;
@@ -75,6 +86,7 @@ void AMXHandler<T>::DestroyHandler(AMX *amx) {
   typename HandlerMap::iterator iterator = handlers_.find(amx);
   if (iterator != handlers_.end()) {
     T *handler = iterator->second;
+    amx_SetUserData(amx, T::kUserDataTag, 0);
     handlers_.erase(iterator);
     delete handler;
   }
@@ -22,41 +22,49 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
-#include <cstdlib>
-#include <cstring>
-#include <iterator>
+#include <cstdio>
+#include <fstream>
 #include <list>
+#include <sstream>
 #include <vector>
-#include <amx/amxaux.h>
 #include "amxpathfinder.h"
 #include "fileutils.h"
 
-AMXPathFinder::AMXFile::AMXFile(const std::string &name)
- : amx_(reinterpret_cast<AMX*>(std::malloc(sizeof(*amx_)))),
-   name_(name),
-   mtime_(fileutils::GetModificationTime(name))
-{
-  if (amx_ != 0) {
-    if (aux_LoadProgram(amx_, name.c_str(), 0) != AMX_ERR_NONE) {
-      std::free(amx_);
-      amx_ = 0;
-    }
+namespace {
+
+const uint32_t kFNVOffsetBasis = 2166136261u;
+const uint32_t kFNVPrime = 16777619u;
+
+uint32_t HashBytes(uint32_t hash, const void *data, std::size_t size) {
+  const unsigned char *bytes = static_cast<const unsigned char*>(data);
+  for (std::size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= kFNVPrime;
   }
+  return hash;
 }
 
-AMXPathFinder::AMXFile::~AMXFile() {
-  if (amx_ != 0) {
-    aux_FreeProgram(amx_);
-    std::free(amx_);
-  }
+template<typename T>
+uint32_t HashValue(uint32_t hash, const T &value) {
+  return HashBytes(hash, &value, sizeof(value));
 }
 
-AMXPathFinder::~AMXPathFinder() {
-  for (StringToAMXFileMap::const_iterator mapIter = string_to_amx_file_.begin();
-      mapIter != string_to_amx_file_.end(); ++mapIter)
-  {
-    delete mapIter->second;
+bool ReadAMXHeader(const std::string &path, AMX_HEADER &hdr) {
+  std::FILE *fp = std::fopen(path.c_str(), "rb");
+  if (fp == 0) {
+    return false;
   }
+  bool ok = std::fread(&hdr, sizeof(hdr), 1, fp) == 1;
+  std::fclose(fp);
+  return ok && hdr.magic == AMX_MAGIC;
+}
+
+} // anonymous namespace
+
+AMXPathFinder::AMXPathFinder()
+ : cache_loaded_(false),
+   cache_dirty_(false)
+{
 }
 
 void AMXPathFinder::AddSearchPath(std::string path) {
@@ -67,16 +75,65 @@ void AMXPathFinder::AddKnownFile(AMX *amx, std::string path) {
   amx_to_string_[amx] = path;
 }
 
-std::string AMXPathFinder::Find(AMX *amx) {
-  // Look up in cache first.
-  AMXToStringMap::const_iterator cache_iterator = amx_to_string_.find(amx);
-  if (cache_iterator != amx_to_string_.end()) {
-    return cache_iterator->second;
+// static
+uint32_t AMXPathFinder::GetFingerprint(const AMX_HEADER *hdr) {
+  // size and flags are left out: loading a compact-encoded script expands
+  // the code in memory and the VM is free to adjust flags as it sees fit.
+  uint32_t hash = kFNVOffsetBasis;
+  hash = HashValue(hash, hdr->magic);
+  hash = HashValue(hash, hdr->file_version);
+  hash = HashValue(hash, hdr->amx_version);
+  hash = HashValue(hash, hdr->defsize);
+  hash = HashValue(hash, hdr->cod);
+  hash = HashValue(hash, hdr->dat);
+  hash = HashValue(hash, hdr->hea);
+  hash = HashValue(hash, hdr->stp);
+  hash = HashValue(hash, hdr->cip);
+  hash = HashValue(hash, hdr->publics);
+  hash = HashValue(hash, hdr->natives);
+  hash = HashValue(hash, hdr->libraries);
+  hash = HashValue(hash, hdr->pubvars);
+  hash = HashValue(hash, hdr->tags);
+  hash = HashValue(hash, hdr->nametable);
+  return hash;
+}
+
+bool AMXPathFinder::GetFileInfo(const std::string &path, FileInfo &info) {
+  std::time_t mtime = 0;
+  std::size_t size = 0;
+  bool exists = fileutils::GetModificationTimeAndSize(path, mtime, size);
+
+  StringToFileInfoMap::const_iterator iterator = file_info_.find(path);
+  if (exists
+      && iterator != file_info_.end()
+      && iterator->second.mtime == mtime
+      && iterator->second.size == size) {
+    info = iterator->second;
+    return true;
   }
 
-  std::string result;
+  AMX_HEADER hdr;
+  if (!exists || !ReadAMXHeader(path, hdr)) {
+    if (iterator != file_info_.end()) {
+      file_info_.erase(path);
+      cache_dirty_ = true;
+    }
+    return false;
+  }
+
+  info.mtime = mtime;
+  info.size = size;
+  info.fingerprint = GetFingerprint(&hdr);
+  file_info_[path] = info;
+  cache_dirty_ = true;
+  return true;
+}
 
-  // Load all .amx files in each of the current search paths (non-recursive).
+void AMXPathFinder::ScanSearchPaths() {
+  files_by_fingerprint_.clear();
+
+  // Look at all .amx files in each of the current search paths
+  // (non-recursive).
   for (std::list<std::string>::const_iterator dir_iterator = search_paths_.begin();
       dir_iterator != search_paths_.end(); ++dir_iterator)
   {
@@ -91,32 +148,117 @@ std::string AMXPathFinder::Find(AMX *amx) {
       filename.append(fileutils::kNativePathSepString);
       filename.append(*file_iterator);
 
-      std::time_t mtime = fileutils::GetModificationTime(filename);
-
-      StringToAMXFileMap::iterator script_it = string_to_amx_file_.find(filename);
-      if (script_it == string_to_amx_file_.end() ||
-          script_it->second->mtime() < mtime) {
-        if (script_it != string_to_amx_file_.end()) {
-          string_to_amx_file_.erase(script_it);
-        }
-        AMXFile *script = new AMXFile(filename);
-        if (script != 0 && script->IsLoaded()) {
-          string_to_amx_file_.insert(std::make_pair(filename, script));
-        }
+      FileInfo info;
+      if (GetFileInfo(filename, info)) {
+        files_by_fingerprint_.insert(
+          std::make_pair(info.fingerprint, filename));
       }
     }
   }
+}
 
-  for (StringToAMXFileMap::const_iterator mapIter = string_to_amx_file_.begin();
-      mapIter != string_to_amx_file_.end(); ++mapIter)
-  {
-    const AMX *otherAmx = mapIter->second->amx();
-    if (std::memcmp(amx->base, otherAmx->base, sizeof(AMX_HEADER)) == 0) {
-      result = mapIter->first;
-      amx_to_string_.insert(std::make_pair(amx, result));
+std::string AMXPathFinder::FindIndexedFile(
+    uint32_t fingerprint,
+    bool check_files,
+    std::vector<std::string> *other_matches) {
+  std::string result;
+  std::pair<FingerprintToStringMap::const_iterator,
+            FingerprintToStringMap::const_iterator> range =
+    files_by_fingerprint_.equal_range(fingerprint);
+
+  for (FingerprintToStringMap::const_iterator iterator = range.first;
+       iterator != range.second; ++iterator) {
+    FileInfo info;
+    if (check_files
+        && (!GetFileInfo(iterator->second, info)
+            || info.fingerprint != fingerprint)) {
+      continue;
+    }
+    if (result.empty()) {
+      result = iterator->second;
+    } else if (other_matches != 0) {
+      other_matches->push_back(iterator->second);
+    } else {
       break;
     }
   }
 
   return result;
 }
+
+std::string AMXPathFinder::Find(AMX *amx,
+                                std::vector<std::string> *other_matches) {
+  // Look up in cache first.
+  AMXToStringMap::const_iterator cache_iterator = amx_to_string_.find(amx);
+  if (cache_iterator != amx_to_string_.end()) {
+    return cache_iterator->second;
+  }
+
+  if (!cache_loaded_) {
+    LoadCache();
+  }
+
+  uint32_t fingerprint =
+    GetFingerprint(reinterpret_cast<AMX_HEADER*>(amx->base));
+
+  // Files in the index may have changed since it was built, so they are
+  // checked again. If none match, the file is new or was modified and
+  // the search paths have to be listed again.
+  std::string result = FindIndexedFile(fingerprint, true, other_matches);
+  if (result.empty()) {
+    ScanSearchPaths();
+    result = FindIndexedFile(fingerprint, false, other_matches);
+  }
+
+  if (!result.empty()) {
+    amx_to_string_.insert(std::make_pair(amx, result));
+  }
+
+  if (cache_dirty_) {
+    SaveCache();
+  }
+
+  return result;
+}
+
+void AMXPathFinder::LoadCache() {
+  cache_loaded_ = true;
+  if (cache_file_.empty()) {
+    return;
+  }
+
+  std::ifstream stream(cache_file_.c_str());
+  std::string line;
+
+  // Each line is: <fingerprint> <mtime> <size> <path>
+  while (std::getline(stream, line)) {
+    std::istringstream line_stream(line);
+    FileInfo info;
+    long long mtime;
+    unsigned long size;
+    line_stream >> std::hex >> info.fingerprint >> std::dec >> mtime >> size;
+    std::string path;
+    if (line_stream.get() == ' ' && std::getline(line_stream, path)) {
+      info.mtime = static_cast<std::time_t>(mtime);
+      info.size = static_cast<std::size_t>(size);
+      file_info_[path] = info;
+    }
+  }
+}
+
+void AMXPathFinder::SaveCache() {
+  cache_dirty_ = false;
+  if (cache_file_.empty()) {
+    return;
+  }
+
+  std::ofstream stream(cache_file_.c_str());
+  for (StringToFileInfoMap::const_iterator iterator = file_info_.begin();
+       iterator != file_info_.end(); ++iterator) {
+    const FileInfo &info = iterator->second;
+    stream << std::hex << info.fingerprint << std::dec << ' '
+           << static_cast<long long>(info.mtime) << ' '
+           << static_cast<unsigned long>(info.size) << ' '
+           << iterator->first << '\n';
+  }
+}
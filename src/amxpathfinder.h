@@ -25,57 +25,76 @@
 #ifndef AMXPATHFINDER_H
 #define AMXPATHFINDER_H
 
+#include <cstddef>
 #include <ctime>
 #include <list>
 #include <map>
 #include <string>
+#include <vector>
 #include <amx/amx.h>
 
 class AMXPathFinder {
  public:
-  ~AMXPathFinder();
+  AMXPathFinder();
 
   void AddSearchPath(std::string path);
   void AddKnownFile(AMX *amx, std::string path);
 
-  std::string Find(AMX *amx);
+  // Fingerprints of scanned files are remembered in this file between
+  // server restarts, keyed by path, modification time and size, so that
+  // unchanged files don't even have to be opened. Leave empty to disable.
+  void set_cache_file(const std::string &path) {
+    cache_file_ = path;
+  }
 
- private:
-  std::list<std::string> search_paths_;
+  // Returns the path of the file the script was loaded from, or an empty
+  // string if there is none. Files are matched by fingerprint, if other
+  // files have the same one their paths are added to other_matches.
+  std::string Find(AMX *amx, std::vector<std::string> *other_matches = 0);
+
+  // Computes a hash of the fields of an AMX header that stay the same
+  // after the VM has loaded the script, so the header of a running AMX
+  // can be matched against the one read from disk.
+  static uint32_t GetFingerprint(const AMX_HEADER *hdr);
 
-  class AMXFile {
-   public:
-    explicit AMXFile(const std::string &name);
-    ~AMXFile();
-
-    bool IsLoaded() const { return amx_ != 0; }
-
-    const AMX *amx() const {
-      return amx_;
-    }
-    const std::string &name() const {
-      return name_;
-    }
-    std::time_t mtime() const {
-      return mtime_;
-    }
-
-   private:
-    AMXFile(const AMXFile &other);
-    AMXFile &operator=(const AMXFile &other);
-
-   private:
-    AMX *amx_;
-    std::string name_;
-    std::time_t mtime_;
+ private:
+  struct FileInfo {
+    std::time_t mtime;
+    std::size_t size;
+    uint32_t fingerprint;
   };
 
+  bool GetFileInfo(const std::string &path, FileInfo &info);
+
+  // Lists the .amx files in the search paths and indexes them by
+  // fingerprint. Only new or modified files are actually read.
+  void ScanSearchPaths();
+
+  // Looks the fingerprint up in the index. If check_files is true, files
+  // that have changed since they were indexed are skipped.
+  std::string FindIndexedFile(uint32_t fingerprint,
+                              bool check_files,
+                              std::vector<std::string> *other_matches);
+
+  void LoadCache();
+  void SaveCache();
+
  private:
-  typedef std::map<std::string, AMXFile*> StringToAMXFileMap;
-  StringToAMXFileMap string_to_amx_file_;
+  std::list<std::string> search_paths_;
+
+  typedef std::map<std::string, FileInfo> StringToFileInfoMap;
+  StringToFileInfoMap file_info_;
+
+  // Built by the first Find() and only rebuilt when a script is not in it.
+  typedef std::multimap<uint32_t, std::string> FingerprintToStringMap;
+  FingerprintToStringMap files_by_fingerprint_;
 
   typedef std::map<AMX*, std::string> AMXToStringMap;
   AMXToStringMap amx_to_string_;
+
+  std::string cache_file_;
+  bool cache_loaded_;
+  bool cache_dirty_;
 };
 
 #endif // AMXPATHFINDER_H
@@ -23,6 +23,7 @@
 // POSSIBILITY OF SUCH DAMAGE.
 
 #include <cassert>
+#include <cstring>
 #include "amx_utils.h"
 
 namespace amxprof {
@@ -69,6 +70,79 @@ unsigned char *GetAmxDataPtr(AMX *amx) {
                           : amx->base + GetAmxHeader(amx)->dat;
 }
 
+// Characters that can appear in the text a script passes to a native:
+// anything printable and whitespace, but no other control codes (C0, DEL
+// or C1). Small numbers and the bytes of most floats fail this.
+bool IsTextCharacter(ucell c) {
+  return (c >= 0x20 && c < 0x7F) || c >= 0xA0
+         || c == '\t' || c == '\n' || c == '\r';
+}
+
+// Returns the length of the string at the given data address, or 0 if
+// there is no string there. If num_cells is not null it receives the
+// number of cells the string occupies, including the terminator.
+//
+// Natives have no signatures, so this is only a guess: the address must
+// point to a zero-terminated run of text characters. Address 0 is never
+// taken for a string because it is far more often an ID or a flag than
+// the first global variable.
+long GetStringLength(AMX *amx,
+                     unsigned char *data,
+                     cell address,
+                     long *num_cells = 0) {
+  cell end;
+  if (address >= amx->stk && address < amx->stp) {
+    end = amx->stp;
+  } else if (address > 0 && address < amx->hea) {
+    end = amx->hea;
+  } else {
+    return 0;
+  }
+  if (address % sizeof(cell) != 0) {
+    return 0;
+  }
+
+  const cell *string = reinterpret_cast<cell*>(data + address);
+  long max_length = static_cast<long>((end - address) / sizeof(cell));
+  long length = 0;
+
+  if (static_cast<ucell>(string[0]) > UNPACKEDMAX) {
+    // Packed strings have up to sizeof(cell) characters per cell, the
+    // first one in the most significant byte.
+    for (long i = 0; i < max_length; i++) {
+      ucell c = static_cast<ucell>(string[i]);
+      for (int shift = (sizeof(cell) - 1) * 8; shift >= 0; shift -= 8) {
+        ucell byte = (c >> shift) & 0xFF;
+        if (byte == 0) {
+          if (num_cells != 0) {
+            *num_cells = i + 1;
+          }
+          return length;
+        }
+        if (!IsTextCharacter(byte)) {
+          return 0;
+        }
+        length++;
+      }
+    }
+    return 0;
+  }
+
+  for (; length < max_length; length++) {
+    cell c = string[length];
+    if (c == 0) {
+      if (num_cells != 0) {
+        *num_cells = length + 1;
+      }
+      return length;
+    }
+    if (c < 0 || c > 0xFFFF || !IsTextCharacter(c)) {
+      return 0;
+    }
+  }
+  return 0;
+}
+
 } // anonymous namespace
 
 cell RelocateOpcode(cell opcode) {
@@ -119,6 +193,18 @@ const char *GetNativeName(AMX *amx, NativeTableIndex index) {
   return "";
 }
 
+NativeTableIndex FindNative(AMX *amx, const char *name) {
+  NativeTableIndex num_natives = 0;
+  amx_NumNatives(amx, &num_natives);
+
+  for (NativeTableIndex index = 0; index < num_natives; index++) {
+    if (std::strcmp(GetNativeName(amx, index), name) == 0) {
+      return index;
+    }
+  }
+  return -1;
+}
+
 const char *GetPublicName(AMX *amx, PublicTableIndex index) {
   AMX_HEADER *amxhdr = GetAmxHeader(amx);
 
@@ -167,4 +253,43 @@ Address GetCalleeAddress(AMX *amx, Address frame) {
   return target - reinterpret_cast<Address>(code);
 }
 
+Address GetNativeCallSite(AMX *amx) {
+  // The VM sets CIP to the next instruction before calling the native,
+  // which may be on another line. The SYSREQ.C operand is right before it.
+  if (amx->cip <= 0) {
+    return 0;
+  }
+  return amx->cip - sizeof(cell);
+}
+
+long GetStringArgumentsLength(AMX *amx, const cell *params) {
+  unsigned char *data = GetAmxDataPtr(amx);
+  int num_args = static_cast<int>(params[0] / sizeof(cell));
+  long length = 0;
+  for (int i = 1; i <= num_args; i++) {
+    length += GetStringLength(amx, data, params[i]);
+  }
+  return length;
+}
+
+uint32_t HashNativeCall(AMX *amx, NativeTableIndex index, const cell *params) {
+  // FNV-1a over the cells.
+  uint32_t hash = 2166136261u;
+  hash = (hash ^ static_cast<uint32_t>(index)) * 16777619u;
+
+  unsigned char *data = GetAmxDataPtr(amx);
+  int num_args = static_cast<int>(params[0] / sizeof(cell));
+  for (int i = 0; i <= num_args; i++) {
+    hash = (hash ^ static_cast<uint32_t>(params[i])) * 16777619u;
+    long num_cells = 0;
+    if (i > 0 && GetStringLength(amx, data, params[i], &num_cells) > 0) {
+      const cell *string = reinterpret_cast<cell*>(data + params[i]);
+      for (long j = 0; j < num_cells; j++) {
+        hash = (hash ^ static_cast<uint32_t>(string[j])) * 16777619u;
+      }
+    }
+  }
+  return hash != 0 ? hash : 1;
+}
+
 } // naemspace amxprof
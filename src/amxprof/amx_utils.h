@@ -26,6 +26,7 @@
 #define AMXPROF_AMX_UTILS_H
 
 #include "amx_types.h"
+#include "stdint.h"
 
 namespace amxprof {
 
@@ -87,9 +88,29 @@ Address GetPublicAddress(AMX *amx, PublicTableIndex index);
 const char *GetNativeName(AMX *amx, NativeTableIndex index);
 const char *GetPublicName(AMX *amx, PublicTableIndex index);
 
+// Returns the index of the native with the given name, or -1 if the script
+// doesn't use it.
+NativeTableIndex FindNative(AMX *amx, const char *name);
+
 Address GetReturnAddress(AMX *amx, Address frame);
 Address GetCalleeAddress(AMX *amx, Address frame);
 
+// Returns an address within the SYSREQ instruction that called the native
+// function that is currently running.
+Address GetNativeCallSite(AMX *amx);
+
+// Returns the total length of the native arguments that point to strings
+// on the heap, stack or in global data. There is no type information, so
+// any argument other than 0 that points to a zero-terminated run of text
+// characters counts. This is an estimate: a number that happens to be the
+// address of a string is counted too.
+long GetStringArgumentsLength(AMX *amx, const cell *params);
+
+// Returns a hash of the native's index, its arguments and the contents of
+// the strings they point to (as above). Identical calls have equal hashes.
+// The result is never 0.
+uint32_t HashNativeCall(AMX *amx, NativeTableIndex index, const cell *params);
+
 } // naemspace amxprof
 
 #endif // !AMXPROF_AMX_UTILS_H
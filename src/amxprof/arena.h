@@ -0,0 +1,150 @@
+// Copyright (c) 2015 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef AMXPROF_ARENA_H
+#define AMXPROF_ARENA_H
+
+#include <cstddef>
+#include <new>
+#include <vector>
+#include "macros.h"
+
+namespace amxprof {
+
+// Allocates objects of type T in contiguous chunks. Objects never move
+// and are numbered in the order they were created, so both pointers and
+// indices stay valid until the arena is destroyed. There is no way to
+// free individual objects, except for the most recently created one.
+//
+// Chunks are aligned to T's alignment even if it's stricter than what
+// operator new guarantees.
+template<typename T, std::size_t ChunkSize = 256>
+class Arena {
+ public:
+  Arena() : size_(0) {}
+  ~Arena() { Clear(); }
+
+  std::size_t size() const { return size_; }
+
+  T *Get(std::size_t index) {
+    return Chunk(index) + index % ChunkSize;
+  }
+  const T *Get(std::size_t index) const {
+    return chunks_[index / ChunkSize] + index % ChunkSize;
+  }
+
+  T *Create() {
+    T *object = new(NextSlot()) T;
+    size_++;
+    return object;
+  }
+  template<typename A1>
+  T *Create(const A1 &a1) {
+    T *object = new(NextSlot()) T(a1);
+    size_++;
+    return object;
+  }
+  template<typename A1, typename A2>
+  T *Create(const A1 &a1, const A2 &a2) {
+    T *object = new(NextSlot()) T(a1, a2);
+    size_++;
+    return object;
+  }
+  template<typename A1, typename A2, typename A3>
+  T *Create(const A1 &a1, const A2 &a2, const A3 &a3) {
+    T *object = new(NextSlot()) T(a1, a2, a3);
+    size_++;
+    return object;
+  }
+  template<typename A1, typename A2, typename A3, typename A4>
+  T *Create(const A1 &a1, const A2 &a2, const A3 &a3, const A4 &a4) {
+    T *object = new(NextSlot()) T(a1, a2, a3, a4);
+    size_++;
+    return object;
+  }
+
+  // Allocates chunks for up to size objects, so that creating that many
+  // won't allocate.
+  void Reserve(std::size_t size) {
+    while (chunks_.size() * ChunkSize < size) {
+      AllocateChunk();
+    }
+  }
+
+  // Destroys the most recently created object. Its memory is reused by
+  // the next Create().
+  void DestroyLast() {
+    size_--;
+    Get(size_)->~T();
+  }
+
+  // Destroys all objects and frees the memory.
+  void Clear() {
+    for (std::size_t i = 0; i < size_; i++) {
+      Get(i)->~T();
+    }
+    for (std::vector<void*>::const_iterator iterator = blocks_.begin();
+         iterator != blocks_.end(); ++iterator) {
+      ::operator delete(*iterator);
+    }
+    blocks_.clear();
+    chunks_.clear();
+    size_ = 0;
+  }
+
+ private:
+  void AllocateChunk() {
+    std::size_t alignment = AMXPROF_ALIGNOF(T);
+    void *block = ::operator new(sizeof(T) * ChunkSize + alignment - 1);
+    blocks_.push_back(block);
+    std::size_t address = reinterpret_cast<std::size_t>(block);
+    address = (address + alignment - 1) / alignment * alignment;
+    chunks_.push_back(reinterpret_cast<T*>(address));
+  }
+
+  T *Chunk(std::size_t index) {
+    return chunks_[index / ChunkSize];
+  }
+
+  // Returns memory for the next object, it's only counted once the
+  // object has been constructed.
+  void *NextSlot() {
+    if (size_ == chunks_.size() * ChunkSize) {
+      AllocateChunk();
+    }
+    return Get(size_);
+  }
+
+ private:
+  std::vector<T*> chunks_;
+  std::vector<void*> blocks_;
+  std::size_t size_;
+
+ private:
+  AMXPROF_DISALLOW_COPY_AND_ASSIGN(Arena);
+};
+
+} // namespace amxprof
+
+#endif // !AMXPROF_ARENA_H
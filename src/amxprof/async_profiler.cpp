@@ -0,0 +1,293 @@
+// Copyright (c) 2015 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "amx_utils.h"
+#include "async_profiler.h"
+#include "clock.h"
+#include "native_argument_values.h"
+#include "profiler.h"
+
+namespace amxprof {
+
+namespace {
+
+// Call depth that Start() makes room for, same as for Profiler.
+const std::size_t kReservedFrames = 256;
+
+int64_t GetTime() {
+  return static_cast<int64_t>((Clock::Now() - TimePoint()).count());
+}
+
+TimePoint ToTimePoint(int64_t time) {
+  return TimePoint(Nanoseconds(static_cast<double>(time)));
+}
+
+} // anonymous namespace
+
+AsyncProfiler::AsyncProfiler(AMX *amx,
+                             Profiler *profiler,
+                             std::size_t queue_size)
+ : amx_(amx),
+   profiler_(profiler),
+   queue_(queue_size),
+   num_pushed_(0),
+   num_stalls_(0),
+   num_processed_(0),
+   stop_requested_(0)
+{
+}
+
+AsyncProfiler::~AsyncProfiler() {
+  Stop();
+}
+
+bool AsyncProfiler::Start() {
+  if (thread_.is_started()) {
+    return true;
+  }
+  // Most scripts are never profiled in async mode, so the queue is only
+  // allocated here rather than with the profiler.
+  queue_.Allocate();
+  frames_.Reserve(kReservedFrames);
+  AtomicStoreRelease(&stop_requested_, 0);
+  return thread_.Start(ThreadMain, this);
+}
+
+void AsyncProfiler::Stop() {
+  if (thread_.is_started()) {
+    AtomicStoreRelease(&stop_requested_, 1);
+    thread_.Join();
+  }
+}
+
+void AsyncProfiler::Flush() {
+  while (thread_.is_started()
+         && AtomicLoadAcquire(&num_processed_) != num_pushed_) {
+    Thread::Sleep(0);
+  }
+}
+
+int AsyncProfiler::DebugHook(AMX_DEBUG debug) {
+  Address frm = amx_->frm;
+  Address prev_frame = frames_.size() == 0 ? amx_->stp : top_frame()->frame;
+
+  if (frm < prev_frame) {
+    Address callee = GetCalleeAddress(amx_, frm);
+    if (callee != 0) {
+      Frame frame = {callee, frm, true};
+      frames_.Create(frame);
+      PushEvent(EVENT_BREAK, 0, callee, frm);
+    }
+  } else if (frm > prev_frame) {
+    if (top_frame()->is_normal) {
+      PopFrames(0, frm);
+      PushEvent(EVENT_BREAK, 0, 0, frm);
+    }
+  }
+
+  if (debug != 0) {
+    return debug(amx_);
+  }
+  return AMX_ERR_NONE;
+}
+
+int AsyncProfiler::CallbackHook(cell index,
+                                cell *result,
+                                cell *params,
+                                AMX_CALLBACK callback) {
+  if (callback == 0) {
+    callback = ::amx_Callback;
+  }
+
+  if (index >= 0) {
+    Address address = GetNativeAddress(amx_, index);
+    NativeArgumentValues::TrackedArgument *tracked_args = 0;
+    cell tracked_values[NativeArgumentValues::kMaxArgumentsPerNative];
+    int num_args = 0;
+    TimePoint enter_time;
+    if (address != 0) {
+      Frame frame = {address, amx_->frm, false};
+      frames_.Create(frame);
+      num_args = static_cast<int>(params[0] / sizeof(cell));
+      long payload_size = profiler_->native_payload_enabled()
+                          ? GetStringArgumentsLength(amx_, params)
+                          : -1;
+      uint32_t args_hash = profiler_->redundant_calls_enabled()
+                           ? HashNativeCall(amx_, index, params)
+                           : 0;
+      PushEvent(EVENT_NATIVE_ENTER, index, address, amx_->frm,
+                GetNativeCallSite(amx_),
+                static_cast<int32_t>(num_args),
+                static_cast<int32_t>(payload_size),
+                args_hash);
+      // The summaries are only ever touched by this thread.
+      tracked_args = profiler_->native_argument_values()->Find(index);
+      if (tracked_args != 0 && tracked_args->position <= num_args) {
+        int i = 0;
+        for (NativeArgumentValues::TrackedArgument *arg = tracked_args;
+             arg != 0 && arg->position <= num_args;
+             arg = arg->next) {
+          tracked_values[i++] = params[arg->position];
+        }
+        enter_time = Clock::Now();
+      } else {
+        tracked_args = 0;
+      }
+    }
+    int error = callback(amx_, index, result, params);
+    if (address != 0) {
+      if (tracked_args != 0) {
+        Nanoseconds time = Clock::Now() - enter_time;
+        int i = 0;
+        for (NativeArgumentValues::TrackedArgument *arg = tracked_args;
+             arg != 0 && arg->position <= num_args;
+             arg = arg->next) {
+          arg->values.AddCall(tracked_values[i++], time);
+        }
+      }
+      PopFrames(address, 0);
+      PushEvent(EVENT_NATIVE_LEAVE, index, address, 0);
+    }
+    return error;
+  }
+
+  return callback(amx_, index, result, params);
+}
+
+int AsyncProfiler::ExecHook(cell *retval, int index, AMX_EXEC exec) {
+  if (exec == 0) {
+    exec = ::amx_Exec;
+  }
+
+  if (index >= 0 || index == AMX_EXEC_MAIN) {
+    Address address = GetPublicAddress(amx_, index);
+    if (address != 0) {
+      Address frm = amx_->stk - 3 * sizeof(cell);
+      Frame frame = {address, frm, false};
+      frames_.Create(frame);
+      PushEvent(EVENT_PUBLIC_ENTER, index, address, frm);
+    }
+    int error = exec(amx_, retval, index);
+    if (address != 0) {
+      PopFrames(address, 0);
+      PushEvent(EVENT_PUBLIC_LEAVE, index, address, 0);
+    }
+    return error;
+  }
+
+  return exec(amx_, retval, index);
+}
+
+void AsyncProfiler::PushEvent(EventType type,
+                              int32_t index,
+                              Address address,
+                              Address frame,
+                              Address call_site,
+                              int32_t num_args,
+                              int32_t payload_size,
+                              uint32_t args_hash) {
+  if (!thread_.is_started()) {
+    return;
+  }
+
+  Event event;
+  event.time = GetTime();
+  event.type = type;
+  event.index = index;
+  event.address = address;
+  event.frame = frame;
+  event.call_site = call_site;
+  event.num_args = num_args;
+  event.payload_size = payload_size;
+  event.args_hash = args_hash;
+
+  // Losing an event would break the call stack, so if the aggregator
+  // can't keep up there's no choice but to wait for it.
+  if (!queue_.TryPush(event)) {
+    num_stalls_++;
+    do {
+      Thread::Sleep(0);
+    } while (!queue_.TryPush(event));
+  }
+  num_pushed_++;
+}
+
+// Same as the loop in Profiler::LeaveFunction().
+void AsyncProfiler::PopFrames(Address address, Address frame) {
+  while (frames_.size() > 0) {
+    Frame top = *top_frame();
+    frames_.DestroyLast();
+    if (top.address == address
+        || (frame != 0 && frames_.size() > 0 && top_frame()->frame >= frame)) {
+      break;
+    }
+  }
+}
+
+// static
+void AsyncProfiler::ThreadMain(void *arg) {
+  static_cast<AsyncProfiler*>(arg)->ProcessEvents();
+}
+
+void AsyncProfiler::ProcessEvents() {
+  unsigned long num_processed = AtomicLoadAcquire(&num_processed_);
+
+  for (;;) {
+    Event event;
+    if (!queue_.TryPop(&event)) {
+      if (AtomicLoadAcquire(&stop_requested_) != 0 && queue_.is_empty()) {
+        break;
+      }
+      Thread::Sleep(1);
+      continue;
+    }
+
+    TimePoint time = ToTimePoint(event.time);
+    switch (event.type) {
+      case EVENT_BREAK:
+        profiler_->ProcessBreak(event.frame, event.address, time);
+        break;
+      case EVENT_NATIVE_ENTER:
+        profiler_->ProcessNativeEnter(event.index, event.address,
+                                      event.frame, event.call_site,
+                                      event.num_args, event.payload_size,
+                                      event.args_hash, time);
+        break;
+      case EVENT_NATIVE_LEAVE:
+        profiler_->ProcessNativeLeave(event.address, time);
+        break;
+      case EVENT_PUBLIC_ENTER:
+        profiler_->ProcessPublicEnter(event.index, event.address,
+                                      event.frame, time);
+        break;
+      case EVENT_PUBLIC_LEAVE:
+        profiler_->ProcessPublicLeave(event.address, time);
+        break;
+    }
+
+    AtomicStoreRelease(&num_processed_, ++num_processed);
+  }
+}
+
+} // namespace amxprof
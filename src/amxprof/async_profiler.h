@@ -0,0 +1,143 @@
+// Copyright (c) 2015 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef AMXPROF_ASYNC_PROFILER_H
+#define AMXPROF_ASYNC_PROFILER_H
+
+#include <cstddef>
+#include <vector>
+#include "amx_types.h"
+#include "arena.h"
+#include "atomic.h"
+#include "macros.h"
+#include "spsc_queue.h"
+#include "stdint.h"
+#include "thread.h"
+
+namespace amxprof {
+
+class Profiler;
+
+// Moves the work of a Profiler off the AMX thread. The hooks below only
+// read the clock and the AMX state they need and push a small record into
+// a queue; a separate thread pops the records and passes them on to the
+// profiler's Process*() methods, which is where statistics and the call
+// graph are updated.
+//
+// While the aggregator thread is running the profiler must not be used
+// from anywhere else: call Flush() or Stop() first.
+class AsyncProfiler {
+ public:
+  AsyncProfiler(AMX *amx, Profiler *profiler, std::size_t queue_size = 65536);
+  ~AsyncProfiler();
+
+  bool Start();
+  void Stop();
+
+  bool is_started() const { return thread_.is_started(); }
+
+  // Waits until all events pushed so far have been processed. As long as
+  // the hooks are not called the profiler can then be safely accessed.
+  void Flush();
+
+  // Whether there are no function calls in progress, from the AMX thread's
+  // point of view (the profiler's own call stack may lag behind).
+  bool is_call_stack_empty() const { return frames_.size() == 0; }
+
+  // How many times a hook had to wait for the aggregator because the
+  // queue was full.
+  unsigned long num_stalls() const { return num_stalls_; }
+
+  // Same as the Profiler hooks.
+  int DebugHook(AMX_DEBUG debug = 0);
+  int CallbackHook(cell index,
+                   cell *result,
+                   cell *params,
+                   AMX_CALLBACK callback = 0);
+  int ExecHook(cell *retval, int index, AMX_EXEC exec = 0);
+
+ private:
+  enum EventType {
+    EVENT_BREAK,
+    EVENT_NATIVE_ENTER,
+    EVENT_NATIVE_LEAVE,
+    EVENT_PUBLIC_ENTER,
+    EVENT_PUBLIC_LEAVE
+  };
+
+  struct Event {
+    int64_t time;
+    int32_t type;
+    int32_t index;
+    Address address;
+    Address frame;
+    Address call_site;
+    int32_t num_args;
+    int32_t payload_size;
+    uint32_t args_hash;
+  };
+
+  // The AMX thread needs to know the frames of the calls in progress to
+  // tell function entries and exits apart in the debug hook. This mirrors
+  // what Profiler does with its call stack.
+  struct Frame {
+    Address address;
+    Address frame;
+    bool is_normal;
+  };
+
+  void PushEvent(EventType type,
+                 int32_t index,
+                 Address address,
+                 Address frame,
+                 Address call_site = 0,
+                 int32_t num_args = -1,
+                 int32_t payload_size = -1,
+                 uint32_t args_hash = 0);
+  void PopFrames(Address address, Address frame);
+  Frame *top_frame() { return frames_.Get(frames_.size() - 1); }
+
+  static void ThreadMain(void *arg);
+  void ProcessEvents();
+
+ private:
+  AMX *amx_;
+  Profiler *profiler_;
+  SPSCQueue<Event> queue_;
+  Thread thread_;
+  // Only a new maximum depth allocates, Start() makes room for the usual
+  // depths in advance.
+  Arena<Frame, 64> frames_;
+  unsigned long num_pushed_;
+  unsigned long num_stalls_;
+  volatile unsigned long num_processed_;
+  volatile unsigned long stop_requested_;
+
+ private:
+  AMXPROF_DISALLOW_COPY_AND_ASSIGN(AsyncProfiler);
+};
+
+} // namespace amxprof
+
+#endif // !AMXPROF_ASYNC_PROFILER_H
@@ -0,0 +1,85 @@
+// Copyright (c) 2015 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef AMXPROF_ATOMIC_H
+#define AMXPROF_ATOMIC_H
+
+// Just enough atomic operations for passing data between two threads
+// without locks: loads that see everything written before the matching
+// store, and stores that publish everything written before them.
+
+#if defined _MSC_VER
+  #include <intrin.h>
+  #pragma intrinsic(_ReadWriteBarrier)
+#endif
+
+namespace amxprof {
+
+#if defined _MSC_VER
+
+// x86 doesn't reorder loads with other loads or stores with other stores,
+// so only the compiler needs to be prevented from doing that.
+inline unsigned long AtomicLoadAcquire(const volatile unsigned long *ptr) {
+  unsigned long value = *ptr;
+  _ReadWriteBarrier();
+  return value;
+}
+
+inline void AtomicStoreRelease(volatile unsigned long *ptr,
+                               unsigned long value) {
+  _ReadWriteBarrier();
+  *ptr = value;
+}
+
+#elif defined __GNUC__ \
+      && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7))
+
+inline unsigned long AtomicLoadAcquire(const volatile unsigned long *ptr) {
+  return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+}
+
+inline void AtomicStoreRelease(volatile unsigned long *ptr,
+                               unsigned long value) {
+  __atomic_store_n(ptr, value, __ATOMIC_RELEASE);
+}
+
+#else
+
+inline unsigned long AtomicLoadAcquire(const volatile unsigned long *ptr) {
+  unsigned long value = *ptr;
+  __sync_synchronize();
+  return value;
+}
+
+inline void AtomicStoreRelease(volatile unsigned long *ptr,
+                               unsigned long value) {
+  __sync_synchronize();
+  *ptr = value;
+}
+
+#endif
+
+} // namespace amxprof
+
+#endif // !AMXPROF_ATOMIC_H
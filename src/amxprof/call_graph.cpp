@@ -22,43 +22,31 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+#include <algorithm>
 #include "call_graph.h"
 #include "function.h"
 #include "function_statistics.h"
 
 namespace amxprof {
 
-namespace {
-
-class Deleter : public CallGraph::Visitor {
- public:
-  virtual void Visit(const CallGraphNode *node) {
-    delete node;
-  }
-};
-
-} // anonymous namespace
-
 bool CallGraph::CompareStats::operator()(const FunctionStatistics *lhs,
                                          const FunctionStatistics *rhs) const {
   return lhs->function()->address() < rhs->function()->address();
 }
 
 CallGraph::CallGraph()
- : sentinel_(new CallGraphNode(this, 0))
+ : sentinel_(node_arena_.Create(this, static_cast<FunctionStatistics*>(0)))
 {
 }
 
 CallGraph::~CallGraph() {
-  Deleter deleter;
-  Traverse(&deleter);
 }
 
 CallGraphNode *CallGraph::PushCall(FunctionStatistics *stats) {
   CallGraphNode *node = 0;
   NodeMap::iterator iterator = nodes_.find(stats);
   if (iterator == nodes_.end()) {
-    node = new CallGraphNode(this, stats);
+    node = node_arena_.Create(this, stats);
     nodes_.insert(std::make_pair(stats, node));
   } else {
     node = iterator->second;
@@ -97,7 +85,11 @@ CallGraphNode::CallGraphNode(CallGraph *graph,
 }
 
 CallGraphNode *CallGraphNode::AddCallee(CallGraphNode *node) {
-  callees_.insert(node);
+  CalleeList::iterator iterator =
+    std::lower_bound(callees_.begin(), callees_.end(), node);
+  if (iterator == callees_.end() || *iterator != node) {
+    callees_.insert(iterator, node);
+  }
   return node;
 }
 
@@ -26,8 +26,9 @@
 #define AMXPROF_CALL_GRAPH_H
 
 #include <map>
-#include <set>
 #include <stack>
+#include <vector>
+#include "arena.h"
 #include "macros.h"
 
 namespace amxprof {
@@ -64,6 +65,7 @@ class CallGraph {
   void Traverse(Visitor *visitor) const;
 
  private:
+  Arena<CallGraphNode> node_arena_;
   CallGraphNode *sentinel_;
   NodeMap nodes_;
   NodeStack call_stack_;
@@ -82,18 +84,21 @@ class CallGraphNode {
      }
   };
 
+  // Sorted by address so that lookups can use binary search.
+  typedef std::vector<CallGraphNode*> CalleeList;
+
   CallGraphNode(CallGraph *graph, FunctionStatistics *stats);
 
   CallGraph *graph() const { return graph_; }
   FunctionStatistics *stats() const { return stats_; }
 
-  const std::set<CallGraphNode*> &callees() const { return callees_; }
+  const CalleeList &callees() const { return callees_; }
   CallGraphNode *AddCallee(CallGraphNode *node);
 
  private:
   CallGraph *graph_;
   FunctionStatistics *stats_;
-  std::set<CallGraphNode*> callees_;
+  CalleeList callees_;
 
  private:
   AMXPROF_DISALLOW_COPY_AND_ASSIGN(CallGraphNode);
@@ -52,7 +52,7 @@ class CallGraphWriter {
   std::string script_name() const { return script_name_; }
   void set_script_name(std::string script_name) { script_name_ = script_name; }
 
-  std::string root_node_name() const { return root_node_name_; }
+  const std::string &root_node_name() const { return root_node_name_; }
   void set_root_node_name(std::string root_node_name) { root_node_name_ = root_node_name; }
 
  private:
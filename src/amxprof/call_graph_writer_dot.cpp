@@ -58,15 +58,15 @@ void CallGraphWriterDot::WriteNode::Visit(const CallGraphNode *node) {
     return;
   }
 
-  std::string caller_name;
+  const char *caller_name;
   if (node->stats() != 0) {
     caller_name = node->stats()->function()->name();
   } else {
-    caller_name = writer_->root_node_name();
+    caller_name = writer_->root_node_name().c_str();
   }
 
   std::ostream *stream = writer_->stream();
-  std::set<CallGraphNode*>::const_iterator iterator =
+  CallGraphNode::CalleeList::const_iterator iterator =
     node->callees().begin();
 
   for (; iterator != node->callees().end(); ++iterator) {
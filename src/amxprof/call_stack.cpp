@@ -28,21 +28,28 @@
 
 namespace amxprof {
 
-void CallStack::Push(Function *function, Address frame) {
-  FunctionCall *parent = calls_.empty() ? 0 : &calls_.back();
-  Push(FunctionCall(function, frame, parent));
+void CallStack::Push(Function *function,
+                     Address frame,
+                     TimePoint time,
+                     bool timed) {
+  FunctionCall *parent = is_empty() ? 0 : top();
+  FunctionCall call(function, frame, parent);
+  call.set_timed(timed);
+  Push(call, time);
 }
 
-void CallStack::Push(const FunctionCall &call) {
-  calls_.push_back(call);
-  calls_.back().timer()->Start();
+void CallStack::Push(const FunctionCall &call, TimePoint time) {
+  FunctionCall *new_call = calls_.Create(call);
+  if (new_call->is_timed()) {
+    new_call->timer()->Start(time);
+  }
 }
 
-FunctionCall CallStack::Pop() {
-  FunctionCall top = calls_.back();
-  calls_.pop_back();
-  top.timer()->Stop();
-  return top;
+FunctionCall CallStack::Pop(TimePoint time) {
+  FunctionCall call = *top();
+  calls_.DestroyLast();
+  call.timer()->Stop(time);
+  return call;
 }
 
 } // namespace amxprof
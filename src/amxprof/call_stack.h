@@ -25,8 +25,9 @@
 #ifndef AMXPROF_CALL_STACK_H
 #define AMXPROF_CALL_STACK_H
 
-#include <list>
 #include "amx_types.h"
+#include "arena.h"
+#include "clock.h"
 #include "function_call.h"
 
 namespace amxprof {
@@ -35,21 +36,29 @@ class Function;
 
 class CallStack {
  public:
-  void Push(Function *function, Address frame);
-  void Push(const FunctionCall &call);
+  void Push(Function *function,
+            Address frame,
+            TimePoint time,
+            bool timed = true);
+  void Push(const FunctionCall &call, TimePoint time);
 
-  FunctionCall Pop();
+  FunctionCall Pop(TimePoint time);
 
-  bool is_empty() const { return calls_.empty(); }
+  bool is_empty() const { return calls_.size() == 0; }
 
-  FunctionCall *top() { return &calls_.back(); }
-  const FunctionCall *top() const { return &calls_.back(); }
+  // Makes room for calls up to this depth in advance.
+  void Reserve(std::size_t depth) { calls_.Reserve(depth); }
+
+  FunctionCall *top() { return calls_.Get(calls_.size() - 1); }
+  const FunctionCall *top() const { return calls_.Get(calls_.size() - 1); }
+
+  FunctionCall *bottom() { return calls_.Get(0); }
+  const FunctionCall *bottom() const { return calls_.Get(0); }
 
-  FunctionCall *bottom() { return &calls_.front(); }
-  const FunctionCall *bottom() const { return &calls_.front(); }
-  
  private:
-  std::list<FunctionCall> calls_;
+  // Calls must not move because they point to their parents. The memory
+  // of returned calls is reused, so only a new maximum depth allocates.
+  Arena<FunctionCall, 64> calls_;
 };
 
 } // namespace amxprof
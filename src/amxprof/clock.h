@@ -27,6 +27,7 @@
 
 #include <ctime>
 #include "duration.h"
+#include "macros.h"
 
 namespace amxprof {
 
@@ -49,7 +50,25 @@ class TimePoint {
 
 class Clock {
  public:
-  static TimePoint Now();
+  // Returns the current time. If the system clock fails, it returns zero
+  // instead of throwing, and the error is kept for ThrowError().
+  static TimePoint Now() AMXPROF_NOEXCEPT;
+
+  // Returns the CPU time used by the calling thread so far. Unlike Now()
+  // this doesn't advance while the thread is blocked or preempted. Errors
+  // are handled in the same way.
+  static TimePoint ThreadCpuTime() AMXPROF_NOEXCEPT;
+
+  // Throws a SystemError for the first clock failure since the previous
+  // call, if any.
+  static void ThrowError();
+
+ private:
+  static void SetError(const char *function, int code) AMXPROF_NOEXCEPT;
+
+ private:
+  static const char *error_function_;
+  static int error_code_;
 };
 
 } // namespace amxprof
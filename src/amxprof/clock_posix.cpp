@@ -25,16 +25,29 @@
 #include <cerrno>
 #include <ctime>
 #include "clock.h"
-#include "system_error.h"
 
 namespace amxprof {
 
 // static
-TimePoint Clock::Now() {
+TimePoint Clock::Now() AMXPROF_NOEXCEPT_DEF {
   struct timespec ts;
 
   if (clock_gettime(CLOCK_MONOTONIC, &ts) == -1) {
-    throw SystemError("clock_gettime");
+    SetError("clock_gettime", errno);
+    return TimePoint();
+  }
+
+  int64_t ns = static_cast<int64_t>(ts.tv_sec) * 1000000000L + ts.tv_nsec;
+  return Nanoseconds(ns);
+}
+
+// static
+TimePoint Clock::ThreadCpuTime() AMXPROF_NOEXCEPT_DEF {
+  struct timespec ts;
+
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == -1) {
+    SetError("clock_gettime", errno);
+    return TimePoint();
   }
 
   int64_t ns = static_cast<int64_t>(ts.tv_sec) * 1000000000L + ts.tv_nsec;
@@ -25,25 +25,53 @@
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
 #include "clock.h"
-#include "system_error.h"
 
 namespace amxprof {
 
 // static
-TimePoint Clock::Now() {
+TimePoint Clock::Now() AMXPROF_NOEXCEPT_DEF {
   LARGE_INTEGER freq;
   if (QueryPerformanceFrequency(&freq) == 0) {
-    throw SystemError("QueryPerformanceFrequency");
+    SetError("QueryPerformanceFrequency", GetLastError());
+    return TimePoint();
   }
 
   double ns_per_tick = 1E+9 / freq.QuadPart;
 
   LARGE_INTEGER count;
   if (QueryPerformanceCounter(&count) == 0) {
-    throw SystemError("QueryPerformanceCounter");
+    SetError("QueryPerformanceCounter", GetLastError());
+    return TimePoint();
   }
 
   return Nanoseconds(ns_per_tick * count.QuadPart);
 }
 
+// static
+TimePoint Clock::ThreadCpuTime() AMXPROF_NOEXCEPT_DEF {
+  FILETIME creation_time;
+  FILETIME exit_time;
+  FILETIME kernel_time;
+  FILETIME user_time;
+  if (GetThreadTimes(GetCurrentThread(),
+                     &creation_time,
+                     &exit_time,
+                     &kernel_time,
+                     &user_time) == 0) {
+    SetError("GetThreadTimes", GetLastError());
+    return TimePoint();
+  }
+
+  ULARGE_INTEGER kernel;
+  kernel.LowPart = kernel_time.dwLowDateTime;
+  kernel.HighPart = kernel_time.dwHighDateTime;
+
+  ULARGE_INTEGER user;
+  user.LowPart = user_time.dwLowDateTime;
+  user.HighPart = user_time.dwHighDateTime;
+
+  // Both are in 100-nanosecond units.
+  return Nanoseconds(100.0 * (kernel.QuadPart + user.QuadPart));
+}
+
 } // namespace amxprof
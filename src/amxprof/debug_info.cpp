@@ -22,86 +22,540 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
-#include <cstdio>
+#include <algorithm>
 #include <cstring>
 #include <string>
 #include "debug_info.h"
+#include "amx_utils.h"
 
 namespace amxprof {
 
+namespace {
+
+struct CompareFunctionStart {
+  bool operator()(const DebugInfo::FunctionRange &lhs,
+                  const DebugInfo::FunctionRange &rhs) const {
+    return lhs.start < rhs.start;
+  }
+};
+
+struct CompareLineAddress {
+  bool operator()(const DebugInfo::LineEntry &lhs,
+                  const DebugInfo::LineEntry &rhs) const {
+    return lhs.address < rhs.address;
+  }
+};
+
+struct CompareFileAddress {
+  bool operator()(const DebugInfo::FileEntry &lhs,
+                  const DebugInfo::FileEntry &rhs) const {
+    return lhs.address < rhs.address;
+  }
+};
+
+// Reads the code and data sections of an AMX file into cells, expanding
+// them if the file uses compact encoding.
+int ReadImage(const unsigned char *data,
+              std::size_t size,
+              std::vector<cell> *cells,
+              std::size_t *code_size) {
+  if (size < sizeof(AMX_HEADER)) {
+    return AMX_ERR_FORMAT;
+  }
+  const AMX_HEADER *amxhdr = reinterpret_cast<const AMX_HEADER*>(data);
+  if (amxhdr->magic != AMX_MAGIC) {
+    return AMX_ERR_FORMAT;
+  }
+  if (amxhdr->cod < 0 || amxhdr->dat < amxhdr->cod
+      || amxhdr->size < amxhdr->cod
+      || static_cast<std::size_t>(amxhdr->size) > size) {
+    return AMX_ERR_FORMAT;
+  }
+  const unsigned char *ptr = data + amxhdr->cod;
+  const unsigned char *end = data + amxhdr->size;
+
+  cells->clear();
+  if ((amxhdr->flags & AMX_FLAG_COMPACT) != 0) {
+    // Each cell is stored as groups of 7 bits, most significant first,
+    // with the high bit set on all groups but the last. Bit 6 of the first
+    // group is the sign.
+    while (ptr < end) {
+      ucell value = (*ptr & 0x40) != 0 ? ~static_cast<ucell>(0) : 0;
+      do {
+        value = (value << 7) | (*ptr & 0x7f);
+      } while ((*ptr++ & 0x80) != 0 && ptr < end);
+      cells->push_back(static_cast<cell>(value));
+    }
+  } else {
+    cells->resize((end - ptr) / sizeof(cell));
+    if (!cells->empty()) {
+      std::memcpy(&(*cells)[0], ptr, cells->size() * sizeof(cell));
+    }
+  }
+
+  *code_size = (amxhdr->dat - amxhdr->cod) / sizeof(cell);
+  if (*code_size > cells->size()) {
+    return AMX_ERR_FORMAT;
+  }
+  return AMX_ERR_NONE;
+}
+
+// Returns the number of operands of the instruction at code[0], or -1 if
+// it's not a valid instruction.
+int GetNumOperands(const cell *code, std::size_t size) {
+  switch (code[0]) {
+    case OP_NONE: case OP_LOAD_I: case OP_STOR_I: case OP_LIDX:
+    case OP_IDXADDR: case OP_MOVE_PRI: case OP_MOVE_ALT: case OP_XCHG:
+    case OP_PUSH_PRI: case OP_PUSH_ALT: case OP_POP_PRI: case OP_POP_ALT:
+    case OP_PROC: case OP_RET: case OP_RETN: case OP_CALL_PRI:
+    case OP_SHL: case OP_SHR: case OP_SSHR: case OP_SMUL: case OP_SDIV:
+    case OP_SDIV_ALT: case OP_UMUL: case OP_UDIV: case OP_UDIV_ALT:
+    case OP_ADD: case OP_SUB: case OP_SUB_ALT: case OP_AND: case OP_OR:
+    case OP_XOR: case OP_NOT: case OP_NEG: case OP_INVERT:
+    case OP_ZERO_PRI: case OP_ZERO_ALT: case OP_SIGN_PRI: case OP_SIGN_ALT:
+    case OP_EQ: case OP_NEQ: case OP_LESS: case OP_LEQ: case OP_GRTR:
+    case OP_GEQ: case OP_SLESS: case OP_SLEQ: case OP_SGRTR: case OP_SGEQ:
+    case OP_INC_PRI: case OP_INC_ALT: case OP_INC_I: case OP_DEC_PRI:
+    case OP_DEC_ALT: case OP_DEC_I: case OP_SYSREQ_PRI: case OP_JUMP_PRI:
+    case OP_SWAP_PRI: case OP_SWAP_ALT: case OP_NOP: case OP_BREAK:
+      return 0;
+    case OP_LINE: case OP_SRANGE:
+      return 2;
+    case OP_CASETBL:
+      // The number of cases, the default address and a value and address
+      // for each case.
+      if (size < 3 || code[1] < 0
+          || static_cast<ucell>(code[1]) > (size - 3) / 2) {
+        return -1;
+      }
+      return 2 + 2 * code[1];
+    case OP_FILE: case OP_SYMBOL:
+      // Not generated by any compiler that writes the debug info we read.
+      return -1;
+    default:
+      if (code[0] < 0 || code[0] >= NUM_OPCODES) {
+        return -1;
+      }
+      return 1;
+  }
+}
+
+// Tells whether an operand of an instruction is a code address.
+bool IsCodeAddress(cell opcode, int operand) {
+  switch (opcode) {
+    case OP_CALL: case OP_JUMP: case OP_JZER: case OP_JNZ: case OP_JEQ:
+    case OP_JNEQ: case OP_JLESS: case OP_JLEQ: case OP_JGRTR: case OP_JGEQ:
+    case OP_JSLESS: case OP_JSLEQ: case OP_JSGRTR: case OP_JSGEQ:
+    case OP_SWITCH:
+      return true;
+    case OP_CASETBL:
+      return operand >= 2 && operand % 2 == 0;
+    default:
+      return false;
+  }
+}
+
+// Returns where an address would be if there were no BREAK instructions
+// at the given (sorted) addresses.
+Address RemoveBreaks(const std::vector<Address> &breaks, Address address) {
+  std::size_t num_breaks =
+    std::lower_bound(breaks.begin(), breaks.end(), address) - breaks.begin();
+  return address - static_cast<Address>(num_breaks * sizeof(cell));
+}
+
+// Moves an address from code with BREAKs at old_breaks to code with BREAKs
+// at the given addresses, which have been passed through RemoveBreaks()
+// already. An address is moved past all new BREAKs that come before it.
+Address MoveAddress(const std::vector<Address> &old_breaks,
+                    const std::vector<Address> &new_breaks,
+                    Address address) {
+  address = RemoveBreaks(old_breaks, address);
+  std::size_t num_breaks =
+    std::lower_bound(new_breaks.begin(), new_breaks.end(), address)
+    - new_breaks.begin();
+  return address + static_cast<Address>(num_breaks * sizeof(cell));
+}
+
+uint32_t HashCell(uint32_t hash, cell value) {
+  ucell bits = static_cast<ucell>(value);
+  for (std::size_t i = 0; i < sizeof(cell); i++) {
+    hash ^= (bits >> (i * 8)) & 0xff;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+// Hashes the code and data sections of the image with 32-bit FNV-1a as if
+// there were no BREAK instructions: they are skipped and jump targets are
+// moved back accordingly. Builds of the same source with and without
+// -d2 therefore hash the same. Stores the BREAK addresses in breaks.
+int HashImage(const unsigned char *data,
+              std::size_t size,
+              uint32_t *hash,
+              std::vector<Address> *breaks) {
+  std::vector<cell> cells;
+  std::size_t code_size;
+  int error = ReadImage(data, size, &cells, &code_size);
+  if (error != AMX_ERR_NONE) {
+    return error;
+  }
+
+  breaks->clear();
+  for (std::size_t i = 0; i < code_size; ) {
+    int num_operands = GetNumOperands(&cells[i], code_size - i);
+    if (num_operands < 0
+        || static_cast<std::size_t>(num_operands) >= code_size - i) {
+      return AMX_ERR_INVINSTR;
+    }
+    if (cells[i] == OP_BREAK) {
+      breaks->push_back(static_cast<Address>(i * sizeof(cell)));
+    }
+    i += 1 + num_operands;
+  }
+
+  uint32_t h = 2166136261u;
+  for (std::size_t i = 0; i < code_size; ) {
+    cell opcode = cells[i];
+    int num_operands = GetNumOperands(&cells[i], code_size - i);
+    if (opcode != OP_BREAK) {
+      h = HashCell(h, opcode);
+      for (int j = 1; j <= num_operands; j++) {
+        cell operand = cells[i + j];
+        if (IsCodeAddress(opcode, j)) {
+          operand = RemoveBreaks(*breaks, operand);
+        }
+        h = HashCell(h, operand);
+      }
+    }
+    i += 1 + num_operands;
+  }
+  for (std::size_t i = code_size; i < cells.size(); i++) {
+    h = HashCell(h, cells[i]);
+  }
+
+  *hash = h;
+  return AMX_ERR_NONE;
+}
+
+// Returns a pointer past the terminating zero of a string or 0 if it runs
+// past the end.
+const unsigned char *SkipString(const char *s, const unsigned char *end) {
+  const unsigned char *ptr = reinterpret_cast<const unsigned char*>(s);
+  if (ptr >= end) {
+    return 0;
+  }
+  const void *zero = std::memchr(ptr, '\0', end - ptr);
+  if (zero == 0) {
+    return 0;
+  }
+  return static_cast<const unsigned char*>(zero) + 1;
+}
+
+// Returns the last entry whose address is less than or equal to address,
+// i.e. the entry whose range contains it, or 0 if there is no such entry.
+template<typename Index, typename Compare>
+const typename Index::value_type *FindContaining(
+    const Index &index,
+    const typename Index::value_type &key,
+    Compare compare) {
+  typename Index::const_iterator iterator =
+    std::upper_bound(index.begin(), index.end(), key, compare);
+  if (iterator == index.begin()) {
+    return 0;
+  }
+  return &*--iterator;
+}
+
+} // anonymous namespace
+
 DebugInfo::DebugInfo()
  : amxdbg_(0),
-   last_error_(AMX_ERR_NONE)
+   last_error_(AMX_ERR_NONE),
+   code_hash_(0)
 {
 }
 
 DebugInfo::DebugInfo(const AMX_DBG *amxdbg) 
  : amxdbg_(new AMX_DBG),
-   last_error_(AMX_ERR_NONE)
+   last_error_(AMX_ERR_NONE),
+   code_hash_(0)
 {
   std::memcpy(amxdbg_, amxdbg, sizeof(AMX_DBG));
+  // dbg_LoadInfo() reads the whole section into the memory at hdr.
+  last_error_ = IndexDebugSection(
+    reinterpret_cast<const unsigned char*>(amxdbg_->hdr),
+    static_cast<std::size_t>(amxdbg_->hdr->size));
+  if (last_error_ != AMX_ERR_NONE) {
+    ClearIndexes();
+  }
 }
 
 DebugInfo::DebugInfo(const std::string &filename)
  : amxdbg_(0),
-   last_error_(AMX_ERR_NONE)
+   last_error_(AMX_ERR_NONE),
+   code_hash_(0)
 {
   Load(filename);
 }
 
+DebugInfo::~DebugInfo() {
+  Unload();
+}
+
 bool DebugInfo::Load(const std::string &filename) {
-  std::FILE* fp = std::fopen(filename.c_str(), "rb");
-  if (fp != 0) {
-    AMX_DBG amxdbg;
-    last_error_ = dbg_LoadInfo(&amxdbg, fp);
-    if (last_error_ == AMX_ERR_NONE) {
-      amxdbg_ = new AMX_DBG(amxdbg);
-      return true;
-    }
-    fclose(fp);
+  Unload();
+  if (!file_.Open(filename)) {
+    last_error_ = AMX_ERR_NOTFOUND;
+    return false;
   }
-  return false;
+  last_error_ = ParseMappedFile();
+  if (last_error_ != AMX_ERR_NONE) {
+    Unload();
+    return false;
+  }
+  return true;
 }
 
 void DebugInfo::Unload() {
   if (amxdbg_ != 0) {
     last_error_ = dbg_FreeInfo(amxdbg_);
     delete amxdbg_;
+    amxdbg_ = 0;
   }
+  file_.Close();
+  ClearIndexes();
+}
+
+int DebugInfo::ParseMappedFile() {
+  ClearIndexes();
+
+  const unsigned char *data = file_.data();
+
+  if (file_.size() < sizeof(AMX_HEADER)) {
+    return AMX_ERR_FORMAT;
+  }
+  const AMX_HEADER *amxhdr = reinterpret_cast<const AMX_HEADER*>(data);
+  if (amxhdr->magic != AMX_MAGIC) {
+    return AMX_ERR_FORMAT;
+  }
+  if ((amxhdr->flags & AMX_FLAG_DEBUG) == 0) {
+    return AMX_ERR_DEBUG;
+  }
+  int error = HashImage(data, file_.size(), &code_hash_, &breaks_);
+  if (error != AMX_ERR_NONE) {
+    return error;
+  }
+  if (amxhdr->size < 0
+      || static_cast<std::size_t>(amxhdr->size) > file_.size()) {
+    return AMX_ERR_FORMAT;
+  }
+  return IndexDebugSection(data + amxhdr->size, file_.size() - amxhdr->size);
+}
+
+// This is the same walk over the debug info as in dbg_LoadInfo() except
+// that it reads the section in place and only records what we index. Every
+// entry is checked to fit before it is read, so a truncated or corrupt file
+// fails with AMX_ERR_FORMAT.
+int DebugInfo::IndexDebugSection(const unsigned char *section,
+                                 std::size_t size) {
+  if (size < sizeof(AMX_DBG_HDR)) {
+    return AMX_ERR_FORMAT;
+  }
+  const AMX_DBG_HDR *dbghdr = reinterpret_cast<const AMX_DBG_HDR*>(section);
+  if (dbghdr->magic != AMX_DBG_MAGIC) {
+    return AMX_ERR_FORMAT;
+  }
+  const unsigned char *end = section + size;
+  if (dbghdr->size < size) {
+    end = section + dbghdr->size;
+  }
+
+  const unsigned char *ptr = section + sizeof(AMX_DBG_HDR);
+
+  files_.reserve(dbghdr->files);
+  for (int i = 0; i < dbghdr->files; i++) {
+    if (ptr + sizeof(AMX_DBG_FILE) > end) {
+      return AMX_ERR_FORMAT;
+    }
+    const AMX_DBG_FILE *entry = reinterpret_cast<const AMX_DBG_FILE*>(ptr);
+    if ((ptr = SkipString(entry->name, end)) == 0) {
+      return AMX_ERR_FORMAT;
+    }
+    FileEntry file;
+    file.address = static_cast<Address>(entry->address);
+    file.name = entry->name;
+    files_.push_back(file);
+  }
+
+  const AMX_DBG_LINE *linetbl = reinterpret_cast<const AMX_DBG_LINE*>(ptr);
+  std::size_t num_lines = dbghdr->lines;
+
+  // Work around an overflow of the 16-bit line count: as long as the entry
+  // following the line table still looks like a line (addresses keep going
+  // up) there must be another 65536 lines.
+  if (num_lines > 0) {
+    while (ptr + (num_lines + 1) * sizeof(AMX_DBG_LINE) <= end
+           && static_cast<cell>(linetbl[num_lines].address)
+              > static_cast<cell>(linetbl[num_lines - 1].address)) {
+      num_lines += 0x10000;
+    }
+  }
+  if (ptr + num_lines * sizeof(AMX_DBG_LINE) > end) {
+    return AMX_ERR_FORMAT;
+  }
+  ptr += num_lines * sizeof(AMX_DBG_LINE);
+
+  lines_.reserve(num_lines);
+  for (std::size_t i = 0; i < num_lines; i++) {
+    LineEntry line;
+    line.address = static_cast<Address>(linetbl[i].address);
+    line.line = linetbl[i].line;
+    lines_.push_back(line);
+  }
+
+  for (int i = 0; i < dbghdr->symbols; i++) {
+    if (ptr + sizeof(AMX_DBG_SYMBOL) > end) {
+      return AMX_ERR_FORMAT;
+    }
+    const AMX_DBG_SYMBOL *symbol = reinterpret_cast<const AMX_DBG_SYMBOL*>(ptr);
+    if ((ptr = SkipString(symbol->name, end)) == 0) {
+      return AMX_ERR_FORMAT;
+    }
+    ptr += symbol->dim * sizeof(AMX_DBG_SYMDIM);
+    if (ptr > end) {
+      return AMX_ERR_FORMAT;
+    }
+    if (symbol->ident == iFUNCTN && symbol->name[0] != '@') {
+      FunctionRange function;
+      function.start = static_cast<Address>(symbol->codestart);
+      function.end = static_cast<Address>(symbol->codeend);
+      function.name = symbol->name;
+      functions_.push_back(function);
+    }
+  }
+
+  std::stable_sort(functions_.begin(), functions_.end(),
+                   CompareFunctionStart());
+  std::stable_sort(lines_.begin(), lines_.end(), CompareLineAddress());
+  std::stable_sort(files_.begin(), files_.end(), CompareFileAddress());
+
+  return AMX_ERR_NONE;
+}
+
+void DebugInfo::ClearIndexes() {
+  FunctionIndex().swap(functions_);
+  LineIndex().swap(lines_);
+  FileIndex().swap(files_);
+  code_hash_ = 0;
+  std::vector<Address>().swap(breaks_);
+}
+
+void DebugInfo::MoveBreaks(const std::vector<Address> &breaks) {
+  if (breaks == breaks_) {
+    return;
+  }
+
+  // Where each of the new BREAKs would be without any BREAKs.
+  std::vector<Address> moved_breaks(breaks.size());
+  for (std::size_t i = 0; i < breaks.size(); i++) {
+    moved_breaks[i] = RemoveBreaks(breaks, breaks[i]);
+  }
+
+  for (FunctionIndex::iterator iterator = functions_.begin();
+       iterator != functions_.end(); ++iterator) {
+    iterator->start = MoveAddress(breaks_, moved_breaks, iterator->start);
+    iterator->end = MoveAddress(breaks_, moved_breaks, iterator->end);
+  }
+  for (LineIndex::iterator iterator = lines_.begin();
+       iterator != lines_.end(); ++iterator) {
+    iterator->address = MoveAddress(breaks_, moved_breaks, iterator->address);
+  }
+  for (FileIndex::iterator iterator = files_.begin();
+       iterator != files_.end(); ++iterator) {
+    iterator->address = MoveAddress(breaks_, moved_breaks, iterator->address);
+  }
+  breaks_ = breaks;
+}
+
+const DebugInfo::FunctionRange *DebugInfo::FindFunction(
+    Address address) const {
+  FunctionRange key;
+  key.start = address;
+  const FunctionRange *function =
+    FindContaining(functions_, key, CompareFunctionStart());
+  if (function != 0 && function->end > address) {
+    return function;
+  }
+  return 0;
+}
+
+const DebugInfo::FunctionRange *DebugInfo::FindFunctionExact(
+    Address address) const {
+  FunctionRange key;
+  key.start = address;
+  FunctionIndex::const_iterator iterator =
+    std::lower_bound(functions_.begin(), functions_.end(), key,
+                     CompareFunctionStart());
+  if (iterator != functions_.end() && iterator->start == address) {
+    return &*iterator;
+  }
+  return 0;
+}
+
+const DebugInfo::LineEntry *DebugInfo::FindLine(Address address) const {
+  LineEntry key;
+  key.address = address;
+  return FindContaining(lines_, key, CompareLineAddress());
+}
+
+const DebugInfo::FileEntry *DebugInfo::FindFile(Address address) const {
+  FileEntry key;
+  key.address = address;
+  return FindContaining(files_, key, CompareFileAddress());
 }
 
 long DebugInfo::LookupLine(Address address) const {
-  long line = 0;
-  last_error_ = dbg_LookupLine(amxdbg_, address, &line);
-  return line;
+  const LineEntry *line = FindLine(address);
+  if (line == 0) {
+    last_error_ = AMX_ERR_NOTFOUND;
+    return 0;
+  }
+  last_error_ = AMX_ERR_NONE;
+  return line->line;
 }
 
 std::string DebugInfo::LookupFile(Address address) const {
   std::string result;
-  const char *file;
-  last_error_ = dbg_LookupFile(amxdbg_, address, &file);
-  if (last_error_ == AMX_ERR_NONE) {
-    result.assign(file);
+  const FileEntry *file = FindFile(address);
+  if (file == 0) {
+    last_error_ = AMX_ERR_NOTFOUND;
+  } else {
+    last_error_ = AMX_ERR_NONE;
+    result.assign(file->name);
   }
   return result;
 }
 
 std::string DebugInfo::LookupFunction(Address address) const {
   std::string result;
-  const char *function;
-  last_error_ = dbg_LookupFunction(amxdbg_, address, &function);
-  if (last_error_ == AMX_ERR_NONE) {
-    result.assign(function);
+  const FunctionRange *function = FindFunction(address);
+  if (function == 0) {
+    last_error_ = AMX_ERR_NOTFOUND;
+  } else {
+    last_error_ = AMX_ERR_NONE;
+    result.assign(function->name);
   }
   return result;
 }
 
 std::string DebugInfo::LookupFunctionExact(Address address) const {
   std::string result;
-  const char *function;
-  last_error_ = dbg_LookupFunctionExact(amxdbg_, address, &function);
-  if (last_error_ == AMX_ERR_NONE) {
-    result.assign(function);
+  const FunctionRange *function = FindFunctionExact(address);
+  if (function == 0) {
+    last_error_ = AMX_ERR_NOTFOUND;
+  } else {
+    last_error_ = AMX_ERR_NONE;
+    result.assign(function->name);
   }
   return result;
 }
@@ -110,7 +564,21 @@ bool HasDebugInfo(AMX *amx) {
   uint16_t flags;
   amx_Flags(amx, &flags);
   return ((flags & AMX_FLAG_DEBUG) != 0);
-}  
+}
+
+bool GetCodeHash(const std::string &filename,
+                 uint32_t *hash,
+                 std::vector<Address> *breaks) {
+  MappedFile file;
+  if (!file.Open(filename)) {
+    return false;
+  }
+  std::vector<Address> file_breaks;
+  if (breaks == 0) {
+    breaks = &file_breaks;
+  }
+  return HashImage(file.data(), file.size(), hash, breaks) == AMX_ERR_NONE;
+}
 
 } // namespace amxprof
 
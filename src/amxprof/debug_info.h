@@ -25,24 +25,81 @@
 #ifndef AMXPROF_DEBUG_INFO_H
 #define AMXPROF_DEBUG_INFO_H
 
+#include <cstddef>
 #include <string>
+#include <vector>
 #include <amx/amx.h>
 #include <amx/amxdbg.h>
 #include "amx_types.h"
 #include "macros.h"
+#include "mapped_file.h"
 
 namespace amxprof {
 
 class DebugInfo {
  public:
+  // Address range of a function, sorted by start address. Functions never
+  // overlap so this is enough to find the function containing any address.
+  struct FunctionRange {
+    Address start;
+    Address end;
+    const char *name;
+  };
+
+  // Start address of a line or a file, sorted by address. An entry covers
+  // everything up to the start of the next one.
+  struct LineEntry {
+    Address address;
+    long line;
+  };
+
+  struct FileEntry {
+    Address address;
+    const char *name;
+  };
+
+  typedef std::vector<FunctionRange> FunctionIndex;
+  typedef std::vector<LineEntry> LineIndex;
+  typedef std::vector<FileEntry> FileIndex;
+
   DebugInfo();
   explicit DebugInfo(const AMX_DBG *amxdbg);
   explicit DebugInfo(const std::string &filename);
+  ~DebugInfo();
 
+  // Maps the file into memory and indexes its debug info in place: names
+  // point directly into the mapping, so nothing is copied and unloading
+  // only has to unmap the file and drop the indexes.
   bool Load(const std::string &filename);
   void Unload();
 
-  bool is_loaded() const { return amxdbg_ != 0; }
+  bool is_loaded() const { return amxdbg_ != 0 || file_.is_open(); }
+
+  // Hash of the code and data sections of the loaded file, not counting
+  // BREAK instructions. Two files with the same hash were built from the
+  // same source with the same options, except that one may have been
+  // compiled with -d2 and the other without debug info. Only available
+  // when loaded from a file.
+  uint32_t code_hash() const { return code_hash_; }
+
+  // Addresses of the BREAK instructions in the code the indexes refer to.
+  const std::vector<Address> &breaks() const { return breaks_; }
+
+  // Moves all addresses onto a build of the same code (see code_hash())
+  // whose BREAK instructions are at the given addresses, so the debug
+  // info of a -d2 build can be used for a build without BREAKs.
+  void MoveBreaks(const std::vector<Address> &breaks);
+
+  // Sorted address indexes built once at load time. All lookups below
+  // are binary searches over these.
+  const FunctionIndex &functions() const { return functions_; }
+  const LineIndex &lines() const { return lines_; }
+  const FileIndex &files() const { return files_; }
+
+  const FunctionRange *FindFunction(Address address) const;
+  const FunctionRange *FindFunctionExact(Address address) const;
+  const LineEntry *FindLine(Address address) const;
+  const FileEntry *FindFile(Address address) const;
 
   long LookupLine(Address address) const;
   std::string LookupFile(Address address) const;
@@ -51,9 +108,22 @@ class DebugInfo {
 
   int last_error() const { return last_error_; }
 
+ private:
+  int ParseMappedFile();
+  // Indexes the debug info section in place, used for both mapped files
+  // and the sections loaded by dbg_LoadInfo().
+  int IndexDebugSection(const unsigned char *section, std::size_t size);
+  void ClearIndexes();
+
  private:
   AMX_DBG *amxdbg_;
+  MappedFile file_;
   mutable int last_error_;
+  uint32_t code_hash_;
+  std::vector<Address> breaks_;
+  FunctionIndex functions_;
+  LineIndex lines_;
+  FileIndex files_;
 
  private:
   AMXPROF_DISALLOW_COPY_AND_ASSIGN(DebugInfo);
@@ -61,6 +131,12 @@ class DebugInfo {
 
 bool HasDebugInfo(AMX *amx);
 
+// Computes the same hash as DebugInfo::code_hash() for an arbitrary AMX
+// file, with or without debug info, and optionally finds its BREAKs.
+bool GetCodeHash(const std::string &filename,
+                 uint32_t *hash,
+                 std::vector<Address> *breaks = 0);
+
 } // namespace amxprof
 
 #endif // !AMXPROF_DEBUGINFO_H
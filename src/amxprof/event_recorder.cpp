@@ -0,0 +1,151 @@
+// Copyright (c) 2015 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstring>
+#include "event_recorder.h"
+
+namespace amxprof {
+
+const char kEventFileMagic[8] = {'A', 'M', 'X', 'P', 'E', 'V', 'T', '\0'};
+const int32_t kEventFileVersion = 4;
+const int32_t kEventFileByteOrder = 0x01020304;
+
+EventRecorder::EventRecorder()
+ : file_(0)
+{
+}
+
+EventRecorder::~EventRecorder() {
+  Close();
+}
+
+bool EventRecorder::Open(const std::string &filename) {
+  Close();
+
+  file_ = std::fopen(filename.c_str(), "wb");
+  if (file_ == 0) {
+    return false;
+  }
+
+  EventFileHeader header;
+  std::memcpy(header.magic, kEventFileMagic, sizeof(header.magic));
+  header.version = kEventFileVersion;
+  header.byte_order = kEventFileByteOrder;
+
+  if (std::fwrite(&header, sizeof(header), 1, file_) != 1) {
+    Close();
+    return false;
+  }
+  return true;
+}
+
+void EventRecorder::Close() {
+  if (file_ != 0) {
+    std::fclose(file_);
+    file_ = 0;
+  }
+}
+
+void EventRecorder::RecordBreak(Address frm, Address callee, TimePoint time) {
+  WriteType(EVENT_BREAK);
+  WriteInt32(frm);
+  WriteInt32(callee);
+  WriteTime(time);
+}
+
+void EventRecorder::RecordNativeEnter(NativeTableIndex index,
+                                      Address address,
+                                      Address frm,
+                                      Address call_site,
+                                      int num_args,
+                                      long payload_size,
+                                      uint32_t args_hash,
+                                      TimePoint time) {
+  WriteType(EVENT_NATIVE_ENTER);
+  WriteInt32(index);
+  WriteInt32(address);
+  WriteInt32(frm);
+  WriteInt32(call_site);
+  WriteInt32(num_args);
+  WriteInt32(static_cast<int32_t>(payload_size));
+  WriteInt32(static_cast<int32_t>(args_hash));
+  WriteTime(time);
+}
+
+void EventRecorder::RecordNativeLeave(Address address, TimePoint time) {
+  WriteType(EVENT_NATIVE_LEAVE);
+  WriteInt32(address);
+  WriteTime(time);
+}
+
+void EventRecorder::RecordPublicEnter(PublicTableIndex index,
+                                      Address address,
+                                      Address frame,
+                                      TimePoint time) {
+  WriteType(EVENT_PUBLIC_ENTER);
+  WriteInt32(index);
+  WriteInt32(address);
+  WriteInt32(frame);
+  WriteTime(time);
+}
+
+void EventRecorder::RecordPublicLeave(Address address, TimePoint time) {
+  WriteType(EVENT_PUBLIC_LEAVE);
+  WriteInt32(address);
+  WriteTime(time);
+}
+
+void EventRecorder::RecordName(Function::Type type,
+                               TableIndex index,
+                               const char *name) {
+  int32_t length = static_cast<int32_t>(std::strlen(name));
+  WriteType(EVENT_NAME);
+  WriteInt32(type);
+  WriteInt32(index);
+  WriteInt32(length);
+  if (file_ != 0) {
+    std::fwrite(name, 1, length, file_);
+  }
+}
+
+void EventRecorder::WriteType(EventType type) {
+  if (file_ != 0) {
+    std::fputc(type, file_);
+  }
+}
+
+void EventRecorder::WriteInt32(int32_t value) {
+  if (file_ != 0) {
+    std::fwrite(&value, sizeof(value), 1, file_);
+  }
+}
+
+void EventRecorder::WriteTime(TimePoint time) {
+  if (file_ != 0) {
+    int64_t ns = static_cast<int64_t>((time - TimePoint()).count());
+    std::fwrite(&ns, sizeof(ns), 1, file_);
+  }
+}
+
+} // namespace amxprof
@@ -0,0 +1,110 @@
+// Copyright (c) 2015 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef AMXPROF_EVENT_RECORDER_H
+#define AMXPROF_EVENT_RECORDER_H
+
+#include <cstdio>
+#include <string>
+#include "amx_types.h"
+#include "clock.h"
+#include "function.h"
+#include "macros.h"
+
+namespace amxprof {
+
+// Event files start with this header followed by a stream of records,
+// each being a one-byte EventType and its fields in native byte order.
+// Addresses and indexes are stored as 32-bit integers and times as
+// 64-bit nanosecond counts.
+struct EventFileHeader {
+  char magic[8];
+  int32_t version;
+  int32_t byte_order;
+};
+
+enum EventType {
+  EVENT_BREAK = 1,    // frm, callee
+  EVENT_NATIVE_ENTER, // index, address, frm, call site (since version 2),
+                      // number of arguments, payload size (since version 3),
+                      // arguments hash (since version 4)
+  EVENT_NATIVE_LEAVE, // address
+  EVENT_PUBLIC_ENTER, // index, address, frame
+  EVENT_PUBLIC_LEAVE, // address
+  EVENT_NAME          // function type, index, name length, name
+};
+
+extern const char kEventFileMagic[8];
+extern const int32_t kEventFileVersion;
+extern const int32_t kEventFileByteOrder;
+
+// Writes the inputs of the profiler's hooks to a file so that they can be
+// fed back into a Profiler later with EventReplayer. Only events that
+// change the profiler's state are recorded (e.g. not the debug hook calls
+// made on every statement).
+class EventRecorder {
+ public:
+  EventRecorder();
+  ~EventRecorder();
+
+  bool Open(const std::string &filename);
+  void Close();
+
+  bool is_open() const { return file_ != 0; }
+
+  void RecordBreak(Address frm, Address callee, TimePoint time);
+  void RecordNativeEnter(NativeTableIndex index,
+                         Address address,
+                         Address frm,
+                         Address call_site,
+                         int num_args,
+                         long payload_size,
+                         uint32_t args_hash,
+                         TimePoint time);
+  void RecordNativeLeave(Address address, TimePoint time);
+  void RecordPublicEnter(PublicTableIndex index,
+                         Address address,
+                         Address frame,
+                         TimePoint time);
+  void RecordPublicLeave(Address address, TimePoint time);
+
+  // Public and native names can't be looked up without the AMX, so they
+  // are recorded along with the events the first time a function is seen.
+  void RecordName(Function::Type type, TableIndex index, const char *name);
+
+ private:
+  void WriteType(EventType type);
+  void WriteInt32(int32_t value);
+  void WriteTime(TimePoint time);
+
+ private:
+  std::FILE *file_;
+
+ private:
+  AMXPROF_DISALLOW_COPY_AND_ASSIGN(EventRecorder);
+};
+
+} // namespace amxprof
+
+#endif // !AMXPROF_EVENT_RECORDER_H
@@ -0,0 +1,244 @@
+// Copyright (c) 2015 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstring>
+#include <map>
+#include <utility>
+#include <vector>
+#include "event_recorder.h"
+#include "event_replayer.h"
+#include "function.h"
+#include "function_statistics.h"
+#include "profiler.h"
+
+namespace amxprof {
+
+namespace {
+
+class EventReader {
+ public:
+  EventReader(const unsigned char *data, std::size_t size)
+   : ptr_(data),
+     end_(data + size)
+  {
+  }
+
+  bool at_end() const { return ptr_ >= end_; }
+
+  bool ReadType(int *type) {
+    if (ptr_ + 1 > end_) {
+      return false;
+    }
+    *type = *ptr_++;
+    return true;
+  }
+
+  bool ReadInt32(int32_t *value) {
+    return Read(value, sizeof(*value));
+  }
+
+  bool ReadTime(TimePoint *time) {
+    int64_t ns;
+    if (!Read(&ns, sizeof(ns))) {
+      return false;
+    }
+    *time = TimePoint(Nanoseconds(static_cast<double>(ns)));
+    return true;
+  }
+
+  bool ReadString(std::size_t length, std::string *s) {
+    if (static_cast<std::size_t>(end_ - ptr_) < length) {
+      return false;
+    }
+    s->assign(reinterpret_cast<const char*>(ptr_), length);
+    ptr_ += length;
+    return true;
+  }
+
+ private:
+  bool Read(void *value, std::size_t size) {
+    if (static_cast<std::size_t>(end_ - ptr_) < size) {
+      return false;
+    }
+    std::memcpy(value, ptr_, size);
+    ptr_ += size;
+    return true;
+  }
+
+ private:
+  const unsigned char *ptr_;
+  const unsigned char *end_;
+};
+
+typedef std::map<std::pair<int, TableIndex>, std::string> NameMap;
+
+void ApplyNames(Profiler *profiler, const NameMap &names) {
+  std::vector<FunctionStatistics*> fn_stats;
+  profiler->stats()->GetStatistics(fn_stats);
+
+  for (std::vector<FunctionStatistics*>::iterator iterator = fn_stats.begin();
+       iterator != fn_stats.end(); ++iterator) {
+    Function *fn = (*iterator)->function();
+    NameMap::const_iterator name =
+      names.find(std::make_pair(static_cast<int>(fn->type()), fn->index()));
+    if (name != names.end()) {
+      fn->set_name(profiler->strings()->Intern(name->second));
+    }
+  }
+}
+
+} // anonymous namespace
+
+EventReplayer::EventReplayer()
+ : version_(0),
+   num_events_(0)
+{
+}
+
+bool EventReplayer::Open(const std::string &filename) {
+  if (!file_.Open(filename)) {
+    return false;
+  }
+
+  EventFileHeader header;
+  if (file_.size() < sizeof(header)) {
+    Close();
+    return false;
+  }
+  std::memcpy(&header, file_.data(), sizeof(header));
+  if (std::memcmp(header.magic, kEventFileMagic, sizeof(header.magic)) != 0
+      || header.version < 1
+      || header.version > kEventFileVersion
+      || header.byte_order != kEventFileByteOrder) {
+    Close();
+    return false;
+  }
+  version_ = header.version;
+  return true;
+}
+
+void EventReplayer::Close() {
+  file_.Close();
+}
+
+bool EventReplayer::Replay(Profiler *profiler) const {
+  num_events_ = 0;
+  if (!file_.is_open()) {
+    return false;
+  }
+
+  EventReader reader(file_.data() + sizeof(EventFileHeader),
+                     file_.size() - sizeof(EventFileHeader));
+  NameMap names;
+  bool ok = true;
+
+  while (ok && !reader.at_end()) {
+    int type;
+    int32_t index, address, frame, call_site, num_args, payload_size;
+    int32_t args_hash, length;
+    TimePoint time;
+
+    ok = reader.ReadType(&type);
+    if (!ok) {
+      break;
+    }
+
+    switch (type) {
+      case EVENT_BREAK:
+        ok = reader.ReadInt32(&frame)
+          && reader.ReadInt32(&address)
+          && reader.ReadTime(&time);
+        if (ok) {
+          profiler->ProcessBreak(frame, address, time);
+        }
+        break;
+      case EVENT_NATIVE_ENTER:
+        call_site = 0;
+        num_args = -1;
+        payload_size = -1;
+        args_hash = 0;
+        ok = reader.ReadInt32(&index)
+          && reader.ReadInt32(&address)
+          && reader.ReadInt32(&frame)
+          && (version_ < 2 || reader.ReadInt32(&call_site))
+          && (version_ < 3 || (reader.ReadInt32(&num_args)
+                               && reader.ReadInt32(&payload_size)))
+          && (version_ < 4 || reader.ReadInt32(&args_hash))
+          && reader.ReadTime(&time);
+        if (ok) {
+          profiler->ProcessNativeEnter(index, address, frame, call_site,
+                                       num_args, payload_size,
+                                       static_cast<uint32_t>(args_hash),
+                                       time);
+        }
+        break;
+      case EVENT_NATIVE_LEAVE:
+        ok = reader.ReadInt32(&address) && reader.ReadTime(&time);
+        if (ok) {
+          profiler->ProcessNativeLeave(address, time);
+        }
+        break;
+      case EVENT_PUBLIC_ENTER:
+        ok = reader.ReadInt32(&index)
+          && reader.ReadInt32(&address)
+          && reader.ReadInt32(&frame)
+          && reader.ReadTime(&time);
+        if (ok) {
+          profiler->ProcessPublicEnter(index, address, frame, time);
+        }
+        break;
+      case EVENT_PUBLIC_LEAVE:
+        ok = reader.ReadInt32(&address) && reader.ReadTime(&time);
+        if (ok) {
+          profiler->ProcessPublicLeave(address, time);
+        }
+        break;
+      case EVENT_NAME: {
+        int32_t fn_type;
+        std::string name;
+        ok = reader.ReadInt32(&fn_type)
+          && reader.ReadInt32(&index)
+          && reader.ReadInt32(&length)
+          && length >= 0
+          && reader.ReadString(length, &name);
+        if (ok) {
+          names[std::make_pair(static_cast<int>(fn_type), index)] = name;
+        }
+        continue;
+      }
+      default:
+        ok = false;
+        break;
+    }
+
+    if (ok) {
+      num_events_++;
+    }
+  }
+
+  ApplyNames(profiler, names);
+  return ok;
+}
+
+} // namespace amxprof
@@ -0,0 +1,68 @@
+// Copyright (c) 2015 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef AMXPROF_EVENT_REPLAYER_H
+#define AMXPROF_EVENT_REPLAYER_H
+
+#include <cstddef>
+#include <string>
+#include "macros.h"
+#include "mapped_file.h"
+
+namespace amxprof {
+
+class Profiler;
+
+// Feeds events written by EventRecorder into a Profiler. The profiler
+// doesn't need an AMX for this (pass 0 to its constructor) and since all
+// times come from the file the results are the same on every replay.
+class EventReplayer {
+ public:
+  EventReplayer();
+
+  bool Open(const std::string &filename);
+  void Close();
+
+  bool is_open() const { return file_.is_open(); }
+
+  // Replays all events and names the recorded publics and natives. Returns
+  // false if the file is truncated or corrupt, in which case the events
+  // before the bad one have already been processed.
+  bool Replay(Profiler *profiler) const;
+
+  // Number of events processed by the last Replay().
+  std::size_t num_events() const { return num_events_; }
+
+ private:
+  MappedFile file_;
+  int version_;
+  mutable std::size_t num_events_;
+
+ private:
+  AMXPROF_DISALLOW_COPY_AND_ASSIGN(EventReplayer);
+};
+
+} // namespace amxprof
+
+#endif // !AMXPROF_EVENT_REPLAYER_H
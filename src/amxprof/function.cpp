@@ -23,47 +23,89 @@
 // POSSIBILITY OF SUCH DAMAGE.
 
 #include <cassert>
-#include <iomanip>
-#include <sstream>
-#include <string>
+#include <cstdio>
 #include "amx_utils.h"
 #include "debug_info.h"
 #include "function.h"
+#include "string_pool.h"
 
 namespace amxprof {
 
-Function::Function(Type type, Address address, std::string name)
+Function::Function(Type type, Address address, TableIndex index)
  : type_(type),
    address_(address),
-   name_(name)
+   index_(index),
+   name_(""),
+   file_(""),
+   line_(0),
+   stats_(0)
 {
 }
 
 // static
-Function *Function::Normal(Address address, DebugInfo *debug_info) {
-  std::string name;
-
-  if (address != 0 && debug_info != 0 && debug_info->is_loaded()) {
-    name = debug_info->LookupFunctionExact(address);
-  }
-
-  if (name.empty()) {
-    std::stringstream ss;
-    ss << std::setw(8) << std::setfill('0') << std::hex << address;
-    name.append("unknown@").append(ss.str());
-  }
-
-  return new Function(NORMAL, address, name);
+Function Function::Normal(Address address) {
+  return Function(NORMAL, address);
 }
 
 // static
-Function *Function::Public(AMX *amx, PublicTableIndex index) {
-  return new Function(PUBLIC, GetPublicAddress(amx, index), GetPublicName(amx, index));
+Function Function::Public(Address address, PublicTableIndex index) {
+  return Function(PUBLIC, address, index);
 }
 
 // static
-Function *Function::Native(AMX *amx, NativeTableIndex index) {
-  return new Function(NATIVE, GetNativeAddress(amx, index), GetNativeName(amx, index));
+Function Function::Native(Address address, NativeTableIndex index) {
+  return Function(NATIVE, address, index);
+}
+
+void Function::Symbolize(AMX *amx,
+                         const DebugInfo *debug_info,
+                         StringPool *strings) {
+  if (is_symbolized()) {
+    return;
+  }
+
+  switch (type_) {
+    case NORMAL:
+      if (address_ != 0 && debug_info != 0 && debug_info->is_loaded()) {
+        const DebugInfo::FunctionRange *function =
+          debug_info->FindFunctionExact(address_);
+        if (function != 0) {
+          name_ = strings->Intern(function->name);
+        }
+      }
+      break;
+    case PUBLIC:
+      if (amx != 0) {
+        name_ = strings->Intern(GetPublicName(amx, index_));
+      }
+      break;
+    case NATIVE:
+      if (amx != 0) {
+        name_ = strings->Intern(GetNativeName(amx, index_));
+      }
+      break;
+  }
+
+  // Publics have names even without debug info, but the location may
+  // still come from a separate debug file.
+  if (type_ != NATIVE
+      && address_ != 0 && debug_info != 0 && debug_info->is_loaded()) {
+    const DebugInfo::FileEntry *file = debug_info->FindFile(address_);
+    if (file != 0) {
+      file_ = strings->Intern(file->name);
+    }
+    const DebugInfo::LineEntry *line = debug_info->FindLine(address_);
+    if (line != 0) {
+      line_ = line->line;
+    }
+  }
+
+  if (!is_symbolized()) {
+    char name[32];
+    std::sprintf(name, "unknown@%08lx",
+                 static_cast<unsigned long>(static_cast<ucell>(address_)));
+    name_ = strings->Intern(name);
+  }
 }
 
 const char *Function::GetTypeString() const {
@@ -25,13 +25,17 @@
 #ifndef AMXPROF_FUNCTION_FUNCTION_H
 #define AMXPROF_FUNCTION_FUNCTION_H
 
-#include <string>
 #include "amx_types.h"
 
 namespace amxprof {
 
 class DebugInfo;
+class FunctionStatistics;
+class StringPool;
 
+// Functions only carry their address and table index while profiling;
+// names, source files and lines are filled in later by Symbolize(), so
+// the hooks never have to touch debug info or build strings.
 class Function {
  public:
   enum Type {
@@ -40,10 +44,9 @@ class Function {
     NATIVE  // native functions
   };
 
-  // Caller is reponsible for deleting returned Function objects.
-  static Function *Normal(Address address, DebugInfo *debug_info = 0);
-  static Function *Public(AMX *amx, PublicTableIndex index);
-  static Function *Native(AMX *amx, NativeTableIndex index);
+  static Function Normal(Address address);
+  static Function Public(Address address, PublicTableIndex index);
+  static Function Native(Address address, NativeTableIndex index);
 
   // Returns the type of the function.
   Type type() const {
@@ -60,15 +63,55 @@ class Function {
     return address_;
   }
 
-  // Returns the name of the function. Public and native functions
-  // always have a name. Ordinary functions' names are extract from
-  // debugging symbols provided at construction time; if there was
-  // no debug info provided or the function was not found among it
-  // the name is built from the string "unknown@" followed by the
-  // function address in hex.
-  std::string name() const {
+  // Returns the index of the function in the public or native table.
+  // For ordinary functions this is always -1.
+  TableIndex index() const {
+    return index_;
+  }
+
+  // Returns the name of the function, or an empty string if it hasn't
+  // been symbolized yet. Public and native functions always have a name.
+  // Ordinary functions' names are extracted from debugging symbols; if
+  // there was no debug info or the function was not found among it the
+  // name is built from the string "unknown@" followed by the function
+  // address in hex.
+  // The returned string is owned by the StringPool passed to Symbolize().
+  const char *name() const {
     return name_;
   }
+  // The name must outlive the function, normally it comes from a
+  // StringPool.
+  void set_name(const char *name) {
+    name_ = name;
+  }
+
+  // Returns the source file and line where the function starts. These
+  // are only known for ordinary functions and only with debug info.
+  const char *file() const {
+    return file_;
+  }
+  long line() const {
+    return line_;
+  }
+
+  // Resolves the name, file and line of the function. This is meant to
+  // be done in bulk right before writing out the statistics. If amx is 0
+  // (e.g. when replaying recorded events) publics and natives must have
+  // been named with set_name(). Strings are interned in the pool.
+  void Symbolize(AMX *amx, const DebugInfo *debug_info, StringPool *strings);
+
+  bool is_symbolized() const {
+    return name_[0] != '\0';
+  }
+
+  // The function's counters, set by Statistics::AddFunction(). Calls go
+  // through this rather than looking the function up again.
+  FunctionStatistics *statistics() const {
+    return stats_;
+  }
+  void set_statistics(FunctionStatistics *stats) {
+    stats_ = stats;
+  }
 
   // Comparison operators.
   bool operator==(const Function &other) const {
@@ -82,12 +125,16 @@ class Function {
   }
 
  private:
-  Function(Type type, Address address, std::string name);
+  Function(Type type, Address address, TableIndex index = -1);
 
  private:
   Type type_;
   Address address_;
-  std::string name_;
+  TableIndex index_;
+  const char *name_;
+  const char *file_;
+  long line_;
+  FunctionStatistics *stats_;
 };
 
 } // namespace amxprof
@@ -29,13 +29,25 @@ namespace amxprof {
 FunctionCall::FunctionCall(Function *function, Address frame, FunctionCall *parent)
  : fn_(function),
    parent_(parent),
-   frame_(frame)
+   frame_(frame),
+   call_site_(0),
+   num_args_(-1),
+   payload_size_(-1),
+   args_hash_(0),
+   min_stack_(frame),
+   max_heap_(0),
+   enter_heap_(-1),
+   timed_(true),
+   recursive_(false),
+   num_child_calls_(0),
+   num_descendant_calls_(0)
 {
   FunctionCall *current = parent;
 
   while (current != 0) {
     if (current->fn_ == this->fn_) {
       timer_.set_shadow(current->timer());
+      recursive_ = true;
       break;
     }
     current = current->parent_;
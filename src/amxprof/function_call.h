@@ -27,6 +27,7 @@
 
 #include "amx_types.h"
 #include "performance_counter.h"
+#include "stdint.h"
 
 namespace amxprof {
 
@@ -44,6 +45,84 @@ class FunctionCall {
 
   Address frame() const { return frame_; }
 
+  // Where a native function was called from, 0 for other functions.
+  Address call_site() const { return call_site_; }
+  void set_call_site(Address call_site) { call_site_ = call_site; }
+
+  // Number of arguments passed to a native function and the length of
+  // those that are strings, -1 if not known.
+  int num_args() const { return num_args_; }
+  long payload_size() const { return payload_size_; }
+  void set_arguments(int num_args, long payload_size) {
+    num_args_ = num_args;
+    payload_size_ = payload_size;
+  }
+
+  // Hash of a native function and its arguments (see HashNativeCall()),
+  // 0 if not computed.
+  uint32_t args_hash() const { return args_hash_; }
+  void set_args_hash(uint32_t hash) { args_hash_ = hash; }
+
+  // Calls to sampled functions may be left untimed, their timer is never
+  // started.
+  bool is_timed() const { return timed_; }
+  void set_timed(bool timed) { timed_ = timed; }
+
+  // True if the function is already somewhere up the call stack.
+  bool is_recursive() const { return recursive_; }
+
+  // Lowest stack pointer and highest heap pointer seen while this call or
+  // one of its callees was running (see Profiler::FEATURE_MEMORY).
+  void ObserveMemory(Address stk, Address hea) {
+    if (stk < min_stack_) {
+      min_stack_ = stk;
+    }
+    if (hea > max_heap_) {
+      max_heap_ = hea;
+    }
+    if (enter_heap_ < 0) {
+      enter_heap_ = hea;
+    }
+  }
+  void AddChildMemory(const FunctionCall &child) {
+    if (child.min_stack_ < min_stack_) {
+      min_stack_ = child.min_stack_;
+    }
+    if (child.max_heap_ > max_heap_) {
+      max_heap_ = child.max_heap_;
+    }
+  }
+
+  // Stack used below the frame and heap allocated on top of what was
+  // there when the call was first seen, in bytes.
+  long stack_usage() const {
+    return min_stack_ < frame_ ? static_cast<long>(frame_ - min_stack_) : 0;
+  }
+  long heap_usage() const {
+    return enter_heap_ >= 0 && max_heap_ > enter_heap_
+      ? static_cast<long>(max_heap_ - enter_heap_)
+      : 0;
+  }
+
+  // Time this call and its callees spent off the CPU, i.e. blocked or
+  // preempted. Only natives measure it, other calls add up the time of
+  // their callees (see Profiler::FEATURE_CPU_TIME).
+  Nanoseconds off_cpu_time() const { return off_cpu_time_; }
+  void set_off_cpu_time(Nanoseconds time) { off_cpu_time_ = time; }
+  void AddChildOffCpuTime(const FunctionCall &child) {
+    off_cpu_time_ += child.off_cpu_time_;
+  }
+
+  // Number of calls made from this call directly and in total.
+  long num_child_calls() const { return num_child_calls_; }
+  long num_descendant_calls() const { return num_descendant_calls_; }
+
+  // Called when a child call returns.
+  void AddChildCall(const FunctionCall &child) {
+    num_child_calls_++;
+    num_descendant_calls_ += child.num_descendant_calls_ + 1;
+  }
+
   PerformanceCounter *timer() { return &timer_; }
   const PerformanceCounter *timer() const { return &timer_; }
 
@@ -51,6 +130,18 @@ class FunctionCall {
   Function *fn_;
   FunctionCall *parent_;
   Address frame_;
+  Address call_site_;
+  int num_args_;
+  long payload_size_;
+  uint32_t args_hash_;
+  Address min_stack_;
+  Address max_heap_;
+  Address enter_heap_;
+  bool timed_;
+  bool recursive_;
+  long num_child_calls_;
+  long num_descendant_calls_;
+  Nanoseconds off_cpu_time_;
   PerformanceCounter timer_;
 };
 
@@ -22,22 +22,85 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+#include <cmath>
 #include "function_statistics.h"
 
 namespace amxprof {
 
-FunctionStatistics::FunctionStatistics(Function *fn)
+FunctionStatistics::FunctionStatistics(Function *fn,
+                                       FunctionCallCounters *calls,
+                                       FunctionTimeCounters *times,
+                                       FunctionCpuCounters *cpu)
  : fn_(fn),
-   num_calls_(0)
+   calls_(calls),
+   times_(times),
+   cpu_(cpu),
+   args_(0),
+   max_stack_usage_(0),
+   max_heap_usage_(0)
 {
 }
 
-void FunctionStatistics::AdjustSelfTime(Nanoseconds delta) {
-  self_time_ += delta;
+Nanoseconds FunctionStatistics::compensated_self_time() const {
+  Nanoseconds time = Extrapolate(times_->self_time - times_->self_overhead);
+  return time.count() > 0 ? time : Nanoseconds();
 }
 
-void FunctionStatistics::AdjustTotalTime(Nanoseconds delta) {
-  total_time_ += delta;
+Nanoseconds FunctionStatistics::compensated_total_time() const {
+  Nanoseconds time = Extrapolate(times_->total_time - times_->total_overhead);
+  return time.count() > 0 ? time : Nanoseconds();
+}
+
+Nanoseconds FunctionStatistics::on_cpu_time() const {
+  // Sampled functions have their total time extrapolated, while the time
+  // off the CPU is measured for every call.
+  Nanoseconds time = total_time() - cpu_->off_cpu_time;
+  return time.count() > 0 ? time : Nanoseconds();
+}
+
+Nanoseconds FunctionStatistics::average_self_time() const {
+  if (times_->num_samples == 0) {
+    return Nanoseconds();
+  }
+  return Nanoseconds(times_->self_time.count() / times_->num_samples);
+}
+
+Nanoseconds FunctionStatistics::average_total_time() const {
+  if (times_->num_samples == 0) {
+    return Nanoseconds();
+  }
+  return Nanoseconds(times_->total_time.count() / times_->num_samples);
+}
+
+void FunctionStatistics::set_sample_interval(long interval) {
+  if (interval > 1) {
+    calls_->sampled = true;
+  }
+  calls_->sample_interval = interval > 1 ? interval : 1;
+  calls_->sample_countdown = calls_->sample_interval;
+}
+
+void FunctionStatistics::AddSample(Nanoseconds self_time) {
+  times_->num_samples++;
+  times_->self_time_squares += self_time.count() * self_time.count();
+}
+
+double FunctionStatistics::self_time_error() const {
+  if (!calls_->sampled
+      || times_->num_samples < 2
+      || times_->self_time.count() <= 0) {
+    return 0;
+  }
+  double n = static_cast<double>(times_->num_samples);
+  double mean = times_->self_time.count() / n;
+  double variance = (times_->self_time_squares - n * mean * mean) / (n - 1);
+  if (variance <= 0) {
+    return 0;
+  }
+  // Calls are sampled without replacement, hence the correction factor.
+  double fraction = n / calls_->num_calls;
+  double error = std::sqrt(variance / n * (1 - fraction));
+  return 1.96 * error / mean;
 }
 
 } // namespace amxprof
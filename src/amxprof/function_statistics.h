@@ -26,46 +26,183 @@
 #define AMXPROF_FUNCTION_INFO_H
 
 #include "duration.h"
+#include "macros.h"
 
 namespace amxprof {
 
 class Function;
+class NativeArgumentStatistics;
+
+// Counters updated when a function is called.
+struct FunctionCallCounters {
+  FunctionCallCounters()
+   : num_calls(0),
+     sample_interval(1),
+     sample_countdown(1),
+     sampled(false),
+     recursive(false) {}
+
+  long num_calls;
+  long sample_interval;
+  long sample_countdown;
+  bool sampled;
+  bool recursive;
+};
+
+// Counters updated when a timed call returns. They occupy exactly one
+// cache line so that a call doesn't touch two lines.
+struct AMXPROF_ALIGN(64) FunctionTimeCounters {
+  FunctionTimeCounters() : num_samples(0), self_time_squares(0) {}
+
+  long num_samples;
+  double self_time_squares;
+  Nanoseconds self_time;
+  Nanoseconds total_time;
+  Nanoseconds worst_self_time;
+  Nanoseconds worst_total_time;
+  Nanoseconds self_overhead;
+  Nanoseconds total_overhead;
+};
+
+// Updated when a call returns, but only with Profiler::FEATURE_CPU_TIME.
+// The time counters already fill a cache line, so these are kept in
+// another array.
+struct FunctionCpuCounters {
+  Nanoseconds off_cpu_time;
+};
 
 // Various runtime information about a function.
+//
+// The counters themselves are kept by Statistics in separate arrays,
+// see Statistics::AddFunction().
 class FunctionStatistics {
  public:
-  explicit FunctionStatistics(Function *fn);
+  FunctionStatistics(Function *fn,
+                     FunctionCallCounters *calls,
+                     FunctionTimeCounters *times,
+                     FunctionCpuCounters *cpu);
 
   Function *function() { return fn_; }
   const Function *function() const { return fn_; }
 
-  long num_calls() const { return num_calls_; }
-  void AdjustNumCalls(long delta) { num_calls_ += delta; }
+  long num_calls() const { return calls_->num_calls; }
+  void AdjustNumCalls(long delta) { calls_->num_calls += delta; }
+
+  // The number of calls that were actually timed. This is less than
+  // num_calls() if the function is sampled, in which case self_time()
+  // and total_time() are extrapolated from the timed calls.
+  long num_samples() const { return times_->num_samples; }
+
+  Nanoseconds self_time() const { return Extrapolate(times_->self_time); }
+  Nanoseconds total_time() const { return Extrapolate(times_->total_time); }
+
+  // Times with the estimated overhead of profiling subtracted, see
+  // Profiler::CalibrateOverhead().
+  Nanoseconds compensated_self_time() const;
+  Nanoseconds compensated_total_time() const;
+
+  void AdjustOverhead(Nanoseconds self_overhead, Nanoseconds total_overhead) {
+    times_->self_overhead += self_overhead;
+    times_->total_overhead += total_overhead;
+  }
+
+  // Average time of the timed calls.
+  Nanoseconds average_self_time() const;
+  Nanoseconds average_total_time() const;
+
+  // Only one in sample_interval() calls is timed; 1 means every call.
+  bool is_sampled() const { return calls_->sampled; }
+  long sample_interval() const { return calls_->sample_interval; }
+  void set_sample_interval(long interval);
 
-  Nanoseconds self_time() const { return self_time_; }
-  Nanoseconds total_time() const { return total_time_; }
+  // Tells whether the next call is going to be timed.
+  bool IsNextCallTimed() const { return calls_->sample_countdown <= 1; }
 
-  Nanoseconds worst_self_time() const { return worst_self_time_; }
-  Nanoseconds worst_total_time() const { return worst_total_time_; }
+  // Counts a call towards the sample interval and returns true if it
+  // should be timed.
+  bool SampleCall() {
+    if (--calls_->sample_countdown > 0) {
+      return false;
+    }
+    calls_->sample_countdown = calls_->sample_interval;
+    return true;
+  }
+
+  // Records the self time of a timed call.
+  void AddSample(Nanoseconds self_time);
+
+  // Half-width of the 95% confidence interval of self_time(), relative
+  // to self_time(). Zero if the function is not sampled.
+  double self_time_error() const;
+
+  bool is_recursive() const { return calls_->recursive; }
+  void set_recursive(bool recursive) { calls_->recursive = recursive; }
+
+  Nanoseconds worst_self_time() const { return times_->worst_self_time; }
+  Nanoseconds worst_total_time() const { return times_->worst_total_time; }
 
   void set_worst_self_time(Nanoseconds worst_self_time) {
-    worst_self_time_ = worst_self_time;
+    times_->worst_self_time = worst_self_time;
   }
 
   void set_worst_total_time(Nanoseconds worst_total_time) {
-    worst_total_time_ = worst_total_time;
+    times_->worst_total_time = worst_total_time;
+  }
+
+  void AdjustSelfTime(Nanoseconds delta) { times_->self_time += delta; }
+  void AdjustTotalTime(Nanoseconds delta) { times_->total_time += delta; }
+
+  // The most stack and heap space used by a call, including its callees,
+  // in bytes. Only tracked with Profiler::FEATURE_MEMORY.
+  long max_stack_usage() const { return max_stack_usage_; }
+  long max_heap_usage() const { return max_heap_usage_; }
+  void AddMemoryUsage(long stack_usage, long heap_usage) {
+    if (stack_usage > max_stack_usage_) {
+      max_stack_usage_ = stack_usage;
+    }
+    if (heap_usage > max_heap_usage_) {
+      max_heap_usage_ = heap_usage;
+    }
   }
 
-  void AdjustSelfTime(Nanoseconds delta);
-  void AdjustTotalTime(Nanoseconds delta);
+  // The part of total_time() spent off the CPU and the rest. Only tracked
+  // with Profiler::FEATURE_CPU_TIME.
+  Nanoseconds off_cpu_time() const { return cpu_->off_cpu_time; }
+  Nanoseconds on_cpu_time() const;
+  void AdjustOffCpuTime(Nanoseconds delta) { cpu_->off_cpu_time += delta; }
+
+  // Argument histograms, only natives have them.
+  NativeArgumentStatistics *argument_statistics() { return args_; }
+  const NativeArgumentStatistics *argument_statistics() const {
+    return args_;
+  }
+  void set_argument_statistics(NativeArgumentStatistics *args) {
+    args_ = args;
+  }
+
+  // Scales a time measured over the timed calls to all calls.
+  static Nanoseconds Extrapolate(const FunctionCallCounters &calls,
+                                 long num_samples,
+                                 Nanoseconds time) {
+    if (!calls.sampled || num_samples == 0) {
+      return time;
+    }
+    return Nanoseconds(time.count() * calls.num_calls / num_samples);
+  }
+
+ private:
+  Nanoseconds Extrapolate(Nanoseconds time) const {
+    return Extrapolate(*calls_, times_->num_samples, time);
+  }
 
  private:
   Function *fn_;
-  long num_calls_;
-  Nanoseconds self_time_;
-  Nanoseconds total_time_;
-  Nanoseconds worst_self_time_;
-  Nanoseconds worst_total_time_;
+  FunctionCallCounters *calls_;
+  FunctionTimeCounters *times_;
+  FunctionCpuCounters *cpu_;
+  NativeArgumentStatistics *args_;
+  long max_stack_usage_;
+  long max_heap_usage_;
 };
 
 } // namespace amxprof
@@ -32,4 +32,31 @@
   TypeName(const TypeName&); \
   void operator=(const TypeName&)
 
+// Alignment of variables and types, in bytes.
+#if defined _MSC_VER
+  #define AMXPROF_ALIGN(n) __declspec(align(n))
+  #define AMXPROF_ALIGNOF(type) __alignof(type)
+#else
+  #define AMXPROF_ALIGN(n) __attribute__((aligned(n)))
+  #define AMXPROF_ALIGNOF(type) __alignof__(type)
+#endif
+
+// Marks functions that never throw. AMXPROF_NOEXCEPT goes on declarations
+// and AMXPROF_NOEXCEPT_DEF on definitions and explicit instantiations.
+// Before C++11 GCC gets its nothrow attribute instead, which it doesn't
+// accept anywhere but on declarations.
+#if __cplusplus >= 201103L || (defined _MSC_VER && _MSC_VER >= 1900)
+  #define AMXPROF_NOEXCEPT noexcept
+  #define AMXPROF_NOEXCEPT_DEF noexcept
+#elif defined _MSC_VER
+  #define AMXPROF_NOEXCEPT throw()
+  #define AMXPROF_NOEXCEPT_DEF throw()
+#elif defined __GNUC__
+  #define AMXPROF_NOEXCEPT __attribute__((nothrow))
+  #define AMXPROF_NOEXCEPT_DEF
+#else
+  #define AMXPROF_NOEXCEPT
+  #define AMXPROF_NOEXCEPT_DEF
+#endif
+
 #endif // !AMXPROF_MACROS_H
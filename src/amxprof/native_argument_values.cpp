@@ -0,0 +1,113 @@
+// Copyright (c) 2015 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include "native_argument_values.h"
+
+namespace amxprof {
+
+namespace {
+
+bool ByTime(const ArgumentValueCounter *a, const ArgumentValueCounter *b) {
+  return a->time > b->time;
+}
+
+} // anonymous namespace
+
+ArgumentValueSummary::ArgumentValueSummary()
+ : num_calls_(0)
+{
+  for (int i = 0; i < kNumCounters; i++) {
+    counters_[i].value = 0;
+    counters_[i].num_calls = 0;
+  }
+}
+
+void ArgumentValueSummary::AddCall(cell value, Nanoseconds time) {
+  num_calls_++;
+  total_time_ += time;
+
+  ArgumentValueCounter *min_counter = &counters_[0];
+  for (int i = 0; i < kNumCounters; i++) {
+    ArgumentValueCounter *counter = &counters_[i];
+    if (counter->num_calls > 0 && counter->value == value) {
+      counter->num_calls++;
+      counter->time += time;
+      return;
+    }
+    if (counter->num_calls == 0
+        || (min_counter->num_calls > 0 && counter->time < min_counter->time)) {
+      min_counter = counter;
+    }
+  }
+
+  min_counter->value = value;
+  min_counter->error = min_counter->time;
+  min_counter->num_calls++;
+  min_counter->time += time;
+}
+
+void ArgumentValueSummary::GetTopValues(
+    std::vector<const ArgumentValueCounter*> &values) const {
+  std::size_t first = values.size();
+  for (int i = 0; i < kNumCounters; i++) {
+    if (counters_[i].num_calls > 0) {
+      values.push_back(&counters_[i]);
+    }
+  }
+  std::sort(values.begin() + first, values.end(), ByTime);
+}
+
+NativeArgumentValues::NativeArgumentValues() {
+}
+
+bool NativeArgumentValues::Track(NativeTableIndex index, int position) {
+  if (index < 0 || position < 1) {
+    return false;
+  }
+  if (static_cast<std::size_t>(index) >= natives_.size()) {
+    natives_.resize(index + 1, 0);
+  }
+  TrackedArgument **link = &natives_[index];
+  int count = 0;
+  for (TrackedArgument *arg = natives_[index]; arg != 0; arg = arg->next) {
+    if (arg->position == position) {
+      return false;
+    }
+    if (arg->position < position) {
+      link = &arg->next;
+    }
+    count++;
+  }
+  if (count >= kMaxArgumentsPerNative) {
+    return false;
+  }
+  TrackedArgument *arg = arguments_.Create();
+  arg->position = position;
+  arg->next = *link;
+  *link = arg;
+  return true;
+}
+
+} // namespace amxprof
@@ -0,0 +1,120 @@
+// Copyright (c) 2015 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef AMXPROF_NATIVE_ARGUMENT_VALUES_H
+#define AMXPROF_NATIVE_ARGUMENT_VALUES_H
+
+#include <cstddef>
+#include <vector>
+#include "amx_types.h"
+#include "arena.h"
+#include "duration.h"
+#include "macros.h"
+
+namespace amxprof {
+
+struct ArgumentValueCounter {
+  cell value;
+  long num_calls;
+  Nanoseconds time;
+  // The time and calls include those of the values this counter was taken
+  // over from, up to this much of the time is not this value's.
+  Nanoseconds error;
+};
+
+// Finds the values of a native argument that take the most time using the
+// Space-Saving algorithm weighted by time. The memory is fixed: there are
+// kNumCounters counters, and a value that doesn't have one takes over the
+// counter with the least time. Any value whose share of the total time is
+// greater than 1 / kNumCounters is guaranteed to have a counter.
+class ArgumentValueSummary {
+ public:
+  enum { kNumCounters = 16 };
+
+  ArgumentValueSummary();
+
+  // Looks at every counter, which is a small constant amount of work.
+  void AddCall(cell value, Nanoseconds time);
+
+  long num_calls() const { return num_calls_; }
+  Nanoseconds total_time() const { return total_time_; }
+
+  // Returns the counters in use, most time first.
+  void GetTopValues(std::vector<const ArgumentValueCounter*> &values) const;
+
+ private:
+  long num_calls_;
+  Nanoseconds total_time_;
+  ArgumentValueCounter counters_[kNumCounters];
+};
+
+// The natives and argument positions selected for tracking and their
+// summaries. Natives are added before profiling starts, after that the
+// hooks only look them up.
+class NativeArgumentValues {
+ public:
+  // How many arguments of the same native can be tracked. The hooks keep
+  // the values on the stack until the native returns.
+  enum { kMaxArgumentsPerNative = 4 };
+
+  struct TrackedArgument {
+    // Position of the argument, starting from 1.
+    int position;
+    ArgumentValueSummary values;
+    // The next tracked argument of the same native, ordered by position.
+    TrackedArgument *next;
+  };
+
+  NativeArgumentValues();
+
+  // Returns false if the argument is already tracked or the native already
+  // has kMaxArgumentsPerNative tracked arguments.
+  bool Track(NativeTableIndex index, int position);
+
+  // Returns the first tracked argument of the native, follow next for
+  // the rest.
+
+  TrackedArgument *Find(NativeTableIndex index) {
+    if (index < 0 || static_cast<std::size_t>(index) >= natives_.size()) {
+      return 0;
+    }
+    return natives_[index];
+  }
+  const TrackedArgument *Find(NativeTableIndex index) const {
+    return const_cast<NativeArgumentValues*>(this)->Find(index);
+  }
+
+ private:
+  // Indexed by native table index, null for natives that are not tracked.
+  // Each entry is the head of the native's list of arguments.
+  std::vector<TrackedArgument*> natives_;
+  Arena<TrackedArgument, 16> arguments_;
+
+ private:
+  AMXPROF_DISALLOW_COPY_AND_ASSIGN(NativeArgumentValues);
+};
+
+} // namespace amxprof
+
+#endif // !AMXPROF_NATIVE_ARGUMENT_VALUES_H
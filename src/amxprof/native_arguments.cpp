@@ -0,0 +1,93 @@
+// Copyright (c) 2015 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "native_arguments.h"
+
+namespace amxprof {
+
+NativeArgumentStatistics::NativeArgumentStatistics()
+ : num_calls_(0),
+   num_counted_calls_(0),
+   total_num_args_(0),
+   num_measured_calls_(0),
+   total_payload_size_(0)
+{
+}
+
+void NativeArgumentStatistics::AddCall(int num_args,
+                                       long payload_size,
+                                       Nanoseconds time) {
+  num_calls_++;
+
+  if (num_args >= 0) {
+    int bucket = num_args < kNumArgCountBuckets ? num_args
+                                                : kNumArgCountBuckets - 1;
+    arg_counts_[bucket].num_calls++;
+    arg_counts_[bucket].time += time;
+    num_counted_calls_++;
+    total_num_args_ += num_args;
+  }
+
+  if (payload_size >= 0) {
+    int bucket = GetPayloadBucket(payload_size);
+    payloads_[bucket].num_calls++;
+    payloads_[bucket].time += time;
+    num_measured_calls_++;
+    if (payload_size > 0) {
+      total_payload_size_ += payload_size;
+      payload_time_ += time;
+    }
+  }
+}
+
+double NativeArgumentStatistics::GetAverageNumArgs() const {
+  if (num_counted_calls_ == 0) {
+    return -1;
+  }
+  return static_cast<double>(total_num_args_) / num_counted_calls_;
+}
+
+double NativeArgumentStatistics::GetTimePerByte() const {
+  if (total_payload_size_ == 0) {
+    return 0;
+  }
+  return static_cast<double>(payload_time_.count()) / total_payload_size_;
+}
+
+// static
+long NativeArgumentStatistics::GetPayloadBucketMin(int index) {
+  return index == 0 ? 0 : 1L << (index - 1);
+}
+
+// static
+int NativeArgumentStatistics::GetPayloadBucket(long payload_size) {
+  int bucket = 0;
+  while (payload_size > 0 && bucket < kNumPayloadBuckets - 1) {
+    payload_size >>= 1;
+    bucket++;
+  }
+  return bucket;
+}
+
+} // namespace amxprof
@@ -0,0 +1,104 @@
+// Copyright (c) 2015 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef AMXPROF_NATIVE_ARGUMENTS_H
+#define AMXPROF_NATIVE_ARGUMENTS_H
+
+#include "duration.h"
+#include "macros.h"
+
+namespace amxprof {
+
+// Calls that fell into one histogram bucket and their total time.
+struct NativeArgumentBucket {
+  NativeArgumentBucket() : num_calls(0) {}
+
+  long num_calls;
+  Nanoseconds time;
+};
+
+// Histograms of a native function's argument counts and payload sizes
+// along with the time the calls took, so that calls with unusually large
+// arguments can be told apart from the rest.
+//
+// The payload of a call is the total length of its arguments that look
+// like strings, in characters. It's only measured if the profiler was
+// asked to (see Profiler::set_native_payload_enabled()).
+class NativeArgumentStatistics {
+ public:
+  enum {
+    // The last argument count bucket also counts all calls with more
+    // arguments.
+    kNumArgCountBuckets = 17,
+    // Bucket 0 is for calls without payload, bucket i > 0 is for
+    // payloads of 2^(i-1) to 2^i - 1 characters. The last one is open.
+    kNumPayloadBuckets = 21
+  };
+
+  NativeArgumentStatistics();
+
+  // Either num_args or payload_size may be -1 if it's not known.
+  void AddCall(int num_args, long payload_size, Nanoseconds time);
+
+  long num_calls() const { return num_calls_; }
+
+  const NativeArgumentBucket &arg_count_bucket(int index) const {
+    return arg_counts_[index];
+  }
+  const NativeArgumentBucket &payload_bucket(int index) const {
+    return payloads_[index];
+  }
+
+  // Average number of arguments, -1 if not known.
+  double GetAverageNumArgs() const;
+
+  // Number of calls whose payload was measured and their total payload.
+  long num_measured_calls() const { return num_measured_calls_; }
+  long long total_payload_size() const { return total_payload_size_; }
+
+  // Time per payload character of the calls that had any payload, zero
+  // if there were none.
+  double GetTimePerByte() const;
+
+  // Returns the smallest payload that goes into the bucket.
+  static long GetPayloadBucketMin(int index);
+  static int GetPayloadBucket(long payload_size);
+
+ private:
+  long num_calls_;
+  long num_counted_calls_;
+  long long total_num_args_;
+  long num_measured_calls_;
+  long long total_payload_size_;
+  Nanoseconds payload_time_;
+  NativeArgumentBucket arg_counts_[kNumArgCountBuckets];
+  NativeArgumentBucket payloads_[kNumPayloadBuckets];
+
+ private:
+  AMXPROF_DISALLOW_COPY_AND_ASSIGN(NativeArgumentStatistics);
+};
+
+} // namespace amxprof
+
+#endif // !AMXPROF_NATIVE_ARGUMENTS_H
@@ -0,0 +1,98 @@
+// Copyright (c) 2015 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include "native_call_history.h"
+
+namespace amxprof {
+
+namespace {
+
+// The table is never filled beyond this many slots out of 4 to keep the
+// probe sequences short.
+const std::size_t kMaxLoad = 3;
+
+} // anonymous namespace
+
+NativeCallHistory::NativeCallHistory(std::size_t capacity)
+ : capacity_(1),
+   size_(0),
+   generation_(1),
+   num_dropped_calls_(0)
+{
+  while (capacity_ < capacity) {
+    capacity_ *= 2;
+  }
+}
+
+void NativeCallHistory::Allocate() {
+  if (slots_.empty()) {
+    Slot empty = {0, 0, 0};
+    slots_.resize(capacity_, empty);
+  }
+}
+
+long NativeCallHistory::AddCall(uint32_t hash) {
+  if (hash == 0) {
+    return 0;
+  }
+  if (slots_.empty()) {
+    num_dropped_calls_++;
+    return 0;
+  }
+
+  std::size_t mask = capacity_ - 1;
+  for (std::size_t i = hash & mask; ; i = (i + 1) & mask) {
+    Slot &slot = slots_[i];
+    if (slot.generation != generation_) {
+      if (size_ >= capacity_ / 4 * kMaxLoad) {
+        num_dropped_calls_++;
+        return 0;
+      }
+      slot.hash = hash;
+      slot.generation = generation_;
+      slot.count = 1;
+      size_++;
+      return 0;
+    }
+    if (slot.hash == hash) {
+      return slot.count++;
+    }
+  }
+}
+
+void NativeCallHistory::Clear() {
+  if (size_ == 0) {
+    return;
+  }
+  size_ = 0;
+  if (++generation_ == 0) {
+    // Slots from 2^32 generations ago would look current again.
+    Slot empty = {0, 0, 0};
+    std::fill(slots_.begin(), slots_.end(), empty);
+    generation_ = 1;
+  }
+}
+
+} // namespace amxprof
@@ -0,0 +1,84 @@
+// Copyright (c) 2015 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef AMXPROF_NATIVE_CALL_HISTORY_H
+#define AMXPROF_NATIVE_CALL_HISTORY_H
+
+#include <cstddef>
+#include <vector>
+#include "macros.h"
+#include "stdint.h"
+
+namespace amxprof {
+
+// Remembers the native calls made during one top-level call into the
+// script, identified by a hash of the native and its arguments (see
+// HashNativeCall()), so that identical calls that are repeated within it
+// can be found.
+//
+// Clear() is O(1): each slot stores the generation it was written in and
+// slots from older generations count as empty. The table has a fixed
+// size, calls that don't fit into it are never seen as repeated.
+class NativeCallHistory {
+ public:
+  enum { kDefaultCapacity = 4096 };
+
+  // The capacity is rounded up to a power of two.
+  explicit NativeCallHistory(std::size_t capacity = kDefaultCapacity);
+
+  // Allocates the table. AddCall() never allocates, calls made before
+  // this are dropped.
+  void Allocate();
+
+  // Returns how many times the same call has been made before since the
+  // last Clear(). A hash of 0 is never remembered.
+  long AddCall(uint32_t hash);
+
+  // Forgets all calls.
+  void Clear();
+
+  // Number of calls that were not remembered because the table was full.
+  long num_dropped_calls() const { return num_dropped_calls_; }
+
+ private:
+  struct Slot {
+    uint32_t hash;
+    uint32_t generation;
+    long count;
+  };
+
+  // Empty until Allocate() is called.
+  std::vector<Slot> slots_;
+  std::size_t capacity_;
+  std::size_t size_;
+  uint32_t generation_;
+  long num_dropped_calls_;
+
+ private:
+  AMXPROF_DISALLOW_COPY_AND_ASSIGN(NativeCallHistory);
+};
+
+} // namespace amxprof
+
+#endif // !AMXPROF_NATIVE_CALL_HISTORY_H
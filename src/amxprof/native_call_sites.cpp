@@ -0,0 +1,162 @@
+// Copyright (c) 2015 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include "debug_info.h"
+#include "native_call_sites.h"
+#include "string_pool.h"
+
+namespace amxprof {
+
+namespace {
+
+// The table is never filled beyond this many slots out of 4 to keep the
+// probe sequences short.
+const std::size_t kMaxLoad = 3;
+
+bool ByTotalTime(const NativeCallSite *a, const NativeCallSite *b) {
+  return a->total_time > b->total_time;
+}
+
+bool ByRedundantTime(const NativeCallSite *a, const NativeCallSite *b) {
+  return a->redundant_time > b->redundant_time;
+}
+
+} // anonymous namespace
+
+NativeCallSites::NativeCallSites(std::size_t capacity)
+ : capacity_(1),
+   size_(0),
+   num_dropped_calls_(0)
+{
+  while (capacity_ < capacity) {
+    capacity_ *= 2;
+  }
+}
+
+void NativeCallSites::Allocate() {
+  if (slots_.empty()) {
+    NativeCallSite empty = {0, 0, 0, 0, Nanoseconds(), 0, Nanoseconds(), 0,
+                            "", 0};
+    slots_.resize(capacity_, empty);
+  }
+}
+
+void NativeCallSites::AddCall(Address address,
+                              Function *native,
+                              Function *caller,
+                              Nanoseconds time,
+                              long repeats) {
+  if (slots_.empty()) {
+    num_dropped_calls_++;
+    return;
+  }
+
+  std::size_t mask = capacity_ - 1;
+  for (std::size_t i = Hash(address, native, caller) & mask; ; i = (i + 1) & mask) {
+    NativeCallSite &site = slots_[i];
+    if (site.native == 0) {
+      if (size_ >= capacity_ / 4 * kMaxLoad) {
+        num_dropped_calls_++;
+        return;
+      }
+      site.address = address;
+      site.native = native;
+      site.caller = caller;
+      size_++;
+    } else if (site.address != address
+               || site.native != native
+               || site.caller != caller) {
+      continue;
+    }
+    site.num_calls++;
+    site.total_time += time;
+    if (repeats > 0) {
+      site.num_redundant_calls++;
+      site.redundant_time += time;
+      if (repeats > site.max_repeats) {
+        site.max_repeats = repeats;
+      }
+    }
+    return;
+  }
+}
+
+void NativeCallSites::GetCallSites(
+    const Function *native,
+    std::vector<const NativeCallSite*> &sites) const {
+  std::size_t first = sites.size();
+  for (std::vector<NativeCallSite>::const_iterator iterator = slots_.begin();
+       iterator != slots_.end(); ++iterator) {
+    if (iterator->native == native) {
+      sites.push_back(&*iterator);
+    }
+  }
+  std::sort(sites.begin() + first, sites.end(), ByTotalTime);
+}
+
+void NativeCallSites::GetRedundantCallSites(
+    std::vector<const NativeCallSite*> &sites) const {
+  std::size_t first = sites.size();
+  for (std::vector<NativeCallSite>::const_iterator iterator = slots_.begin();
+       iterator != slots_.end(); ++iterator) {
+    if (iterator->num_redundant_calls > 0) {
+      sites.push_back(&*iterator);
+    }
+  }
+  std::sort(sites.begin() + first, sites.end(), ByRedundantTime);
+}
+
+void NativeCallSites::Symbolize(const DebugInfo *debug_info,
+                                StringPool *strings) {
+  if (debug_info == 0 || !debug_info->is_loaded()) {
+    return;
+  }
+  for (std::vector<NativeCallSite>::iterator iterator = slots_.begin();
+       iterator != slots_.end(); ++iterator) {
+    if (iterator->native == 0) {
+      continue;
+    }
+    const DebugInfo::FileEntry *file = debug_info->FindFile(iterator->address);
+    if (file != 0) {
+      iterator->file = strings->Intern(file->name);
+    }
+    const DebugInfo::LineEntry *line = debug_info->FindLine(iterator->address);
+    if (line != 0) {
+      iterator->line = line->line;
+    }
+  }
+}
+
+// static
+std::size_t NativeCallSites::Hash(Address address,
+                                  const Function *native,
+                                  const Function *caller) {
+  std::size_t hash = static_cast<std::size_t>(address) / sizeof(cell);
+  hash ^= reinterpret_cast<std::size_t>(native) >> 4;
+  hash ^= reinterpret_cast<std::size_t>(caller) >> 2;
+  return hash * 2654435761u;
+}
+
+} // namespace amxprof
@@ -0,0 +1,114 @@
+// Copyright (c) 2015 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef AMXPROF_NATIVE_CALL_SITES_H
+#define AMXPROF_NATIVE_CALL_SITES_H
+
+#include <cstddef>
+#include <vector>
+#include "amx_types.h"
+#include "duration.h"
+#include "macros.h"
+
+namespace amxprof {
+
+class DebugInfo;
+class Function;
+class StringPool;
+
+// Calls of a native function made from one place in the script.
+struct NativeCallSite {
+  Address address;   // of the SYSREQ instruction (or somewhere inside it)
+  Function *native;
+  Function *caller;
+  long num_calls;
+  Nanoseconds total_time;
+  // Calls identical to an earlier call in the same top-level call into
+  // the script, their time and the most times one call was repeated.
+  long num_redundant_calls;
+  Nanoseconds redundant_time;
+  long max_repeats;
+  const char *file;  // set by NativeCallSites::Symbolize()
+  long line;
+};
+
+// Breaks native function times down by call site and calling function.
+// The native is part of the key too because SYSREQ.PRI can call different
+// natives from one place.
+// This is a fixed-size open addressing table: once it gets full, calls
+// from call sites that aren't in it yet are only counted.
+class NativeCallSites {
+ public:
+  enum { kDefaultCapacity = 8192 };
+
+  // The capacity is rounded up to a power of two.
+  explicit NativeCallSites(std::size_t capacity = kDefaultCapacity);
+
+  // Allocates the table. AddCall() never allocates, calls made before
+  // this are only counted as dropped.
+  void Allocate();
+
+  // The number of times the same call was made before in the current
+  // top-level call, see NativeCallHistory.
+  void AddCall(Address address,
+               Function *native,
+               Function *caller,
+               Nanoseconds time,
+               long repeats = 0);
+
+  std::size_t size() const { return size_; }
+
+  // Number of calls that didn't fit into the table.
+  long num_dropped_calls() const { return num_dropped_calls_; }
+
+  // Returns the call sites of the native, most expensive first.
+  void GetCallSites(const Function *native,
+                    std::vector<const NativeCallSite*> &sites) const;
+
+  // Returns the call sites that made redundant calls, most time wasted
+  // first.
+  void GetRedundantCallSites(std::vector<const NativeCallSite*> &sites) const;
+
+  // Finds the source file and line of each call site.
+  void Symbolize(const DebugInfo *debug_info, StringPool *strings);
+
+ private:
+  static std::size_t Hash(Address address,
+                          const Function *native,
+                          const Function *caller);
+
+ private:
+  // Empty until Allocate() is called. Empty slots have no native.
+  std::vector<NativeCallSite> slots_;
+  std::size_t capacity_;
+  std::size_t size_;
+  long num_dropped_calls_;
+
+ private:
+  AMXPROF_DISALLOW_COPY_AND_ASSIGN(NativeCallSites);
+};
+
+} // namespace amxprof
+
+#endif // !AMXPROF_NATIVE_CALL_SITES_H
@@ -0,0 +1,123 @@
+// Copyright (c) 2015 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "overhead_throttle.h"
+#include "profiler.h"
+
+namespace amxprof {
+
+namespace {
+
+const Seconds kPeriod = Seconds(1);
+
+// Go back up after this many periods below half of the budget. This is
+// doubled every time going up pushes the overhead over the budget again.
+const int kMinQuietPeriods = 5;
+const int kMaxQuietPeriods = 320;
+
+} // anonymous namespace
+
+OverheadThrottle::OverheadThrottle(double max_overhead_percent)
+ : max_overhead_percent_(max_overhead_percent),
+   level_(LEVEL_FULL),
+   overhead_percent_(0),
+   started_(false),
+   num_quiet_periods_(0),
+   num_quiet_periods_needed_(kMinQuietPeriods),
+   stepped_up_(false)
+{
+}
+
+bool OverheadThrottle::Update(const Profiler *profiler, TimePoint now) {
+  if (!is_enabled()) {
+    return false;
+  }
+
+  if (!started_) {
+    period_start_ = now;
+    period_hook_time_ = profiler->GetHookTime();
+    period_script_time_ = profiler->script_time();
+    started_ = true;
+    return false;
+  }
+
+  if (now - period_start_ < kPeriod) {
+    return false;
+  }
+
+  Nanoseconds hook_time = profiler->GetHookTime() - period_hook_time_;
+  Nanoseconds script_time = profiler->script_time() - period_script_time_;
+
+  period_start_ = now;
+  period_hook_time_ = profiler->GetHookTime();
+  period_script_time_ = profiler->script_time();
+
+  if (script_time.count() <= 0) {
+    return false;
+  }
+
+  overhead_percent_ = hook_time.count() * 100 / script_time.count();
+
+  if (overhead_percent_ > max_overhead_percent_) {
+    num_quiet_periods_ = 0;
+    if (stepped_up_ && num_quiet_periods_needed_ < kMaxQuietPeriods) {
+      num_quiet_periods_needed_ *= 2;
+    }
+    stepped_up_ = false;
+    if (level_ != LEVEL_PUBLICS_AND_NATIVES) {
+      level_ = static_cast<Level>(level_ + 1);
+      return true;
+    }
+    return false;
+  }
+
+  stepped_up_ = false;
+
+  if (overhead_percent_ < max_overhead_percent_ / 2 && level_ != LEVEL_FULL) {
+    if (++num_quiet_periods_ >= num_quiet_periods_needed_) {
+      num_quiet_periods_ = 0;
+      stepped_up_ = true;
+      level_ = static_cast<Level>(level_ - 1);
+      return true;
+    }
+  } else {
+    num_quiet_periods_ = 0;
+  }
+
+  return false;
+}
+
+const char *OverheadThrottle::GetLevelString(Level level) {
+  switch (level) {
+    case LEVEL_FULL:
+      return "full";
+    case LEVEL_SAMPLED:
+      return "sampled";
+    case LEVEL_PUBLICS_AND_NATIVES:
+      return "publics and natives only";
+  }
+  return "";
+}
+
+} // namespace amxprof
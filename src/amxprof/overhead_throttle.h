@@ -0,0 +1,87 @@
+// Copyright (c) 2015 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef AMXPROF_OVERHEAD_THROTTLE_H
+#define AMXPROF_OVERHEAD_THROTTLE_H
+
+#include "clock.h"
+#include "duration.h"
+#include "macros.h"
+
+namespace amxprof {
+
+class Profiler;
+
+// Keeps the time spent in the profiler's hooks within a percentage of
+// the time spent running the script. Once a second it compares the two
+// and, if profiling costs too much, suggests a cheaper profiling level.
+// When the overhead drops it suggests going back up, but each time this
+// turns out to be premature it waits longer before trying again.
+class OverheadThrottle {
+ public:
+  enum Level {
+    LEVEL_FULL,
+    LEVEL_SAMPLED,
+    LEVEL_PUBLICS_AND_NATIVES
+  };
+
+  explicit OverheadThrottle(double max_overhead_percent = 0);
+
+  bool is_enabled() const { return max_overhead_percent_ > 0; }
+
+  double max_overhead_percent() const { return max_overhead_percent_; }
+  void set_max_overhead_percent(double percent) {
+    max_overhead_percent_ = percent;
+  }
+
+  Level level() const { return level_; }
+
+  // Overhead measured over the last complete period, in percent.
+  double overhead_percent() const { return overhead_percent_; }
+
+  // Should be called when the call stack is empty. Returns true if the
+  // level has changed and needs to be applied to the profiler.
+  bool Update(const Profiler *profiler, TimePoint now);
+
+  static const char *GetLevelString(Level level);
+
+ private:
+  double max_overhead_percent_;
+  Level level_;
+  double overhead_percent_;
+  bool started_;
+  TimePoint period_start_;
+  Nanoseconds period_hook_time_;
+  Nanoseconds period_script_time_;
+  int num_quiet_periods_;
+  int num_quiet_periods_needed_;
+  bool stepped_up_;
+
+ private:
+  AMXPROF_DISALLOW_COPY_AND_ASSIGN(OverheadThrottle);
+};
+
+} // namespace amxprof
+
+#endif // !AMXPROF_OVERHEAD_THROTTLE_H
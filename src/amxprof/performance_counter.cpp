@@ -34,17 +34,17 @@ PerformanceCounter::PerformanceCounter(PerformanceCounter *parent,
 {
 }
 
-void PerformanceCounter::Start() {
+void PerformanceCounter::Start(TimePoint now) {
   if (!started_) {
-    start_point_ = Clock::Now();
+    start_point_ = now;
     ResetTimes();
     started_ = true;
   }
 }
 
-void PerformanceCounter::Stop() {
+void PerformanceCounter::Stop(TimePoint now) {
   if (started_) {
-    Nanoseconds time = QueryTotalTime();
+    Nanoseconds time = QueryTotalTime(now);
 
     if (shadow_ != 0) {
       latest_total_time_ = 0;
@@ -34,13 +34,18 @@ class PerformanceCounter {
   PerformanceCounter(PerformanceCounter *parent = 0,
                      PerformanceCounter *shadow = 0);
 
-  void Start();
-  void Stop();
+  // Both take the current time so that callers can share one clock
+  // reading between several counters, or supply recorded times.
+  void Start(TimePoint now);
+  void Stop(TimePoint now);
 
   void ResetTimes();
 
   Nanoseconds QueryTotalTime() const {
-    return Clock::Now() - start_point_;
+    return QueryTotalTime(Clock::Now());
+  }
+  Nanoseconds QueryTotalTime(TimePoint now) const {
+    return now - start_point_;
   }
 
   void set_parent(PerformanceCounter *parent) { parent_ = parent; }
@@ -54,6 +59,9 @@ class PerformanceCounter {
   }
 
   Nanoseconds child_time() const { return child_time_; }
+
+  // Used to account for children that weren't timed.
+  void AdjustChildTime(Nanoseconds delta) { child_time_ += delta; }
   Nanoseconds total_time() const { return total_time_; }
 
   Nanoseconds self_time() const {
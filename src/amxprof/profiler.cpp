@@ -22,51 +22,169 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+#include <algorithm>
 #include <cassert>
 #include "amx_utils.h"
+#include "event_recorder.h"
 #include "function.h"
 #include "function_call.h"
 #include "function_statistics.h"
+#include "native_arguments.h"
 #include "profiler.h"
 
 namespace amxprof {
 
+namespace {
+
+// Measuring every hook call would double the number of clock reads,
+// so only one in this many calls is measured.
+const long kHookMeasureInterval = 64;
+
+// Once a function has enough calls to be sampled, UpdateSampling() checks
+// its average time only every this many calls. This keeps the enter path
+// away from the time counters.
+const long kSamplingCheckInterval = 1024;
+
+// Parameters of CalibrateOverhead(). The fastest round is used because
+// slower ones are most likely affected by something else.
+const int kCalibrationRounds = 5;
+const int kCalibrationCalls = 2000;
+
+// Call stack depth that Allocate() makes room for. Deeper calls are rare
+// and allocate when they first happen.
+const std::size_t kReservedCallDepth = 256;
+
+const int kNoFeatures = 0;
+const int kCallGraph = Profiler::FEATURE_CALL_GRAPH;
+
+} // anonymous namespace
+
 Profiler::Profiler(AMX *amx, bool enable_call_graph)
  : amx_(amx),
    debug_info_(0),
-   call_graph_enabled_(enable_call_graph)
+   event_recorder_(0),
+   features_(enable_call_graph ? FEATURE_CALL_GRAPH : 0),
+   hook_table_(GetHookTable(features_)),
+   normal_functions_enabled_(true),
+   sample_interval_(0),
+   sample_min_calls_(0),
+   hook_countdown_(kHookMeasureInterval),
+   num_hook_calls_(0),
+   num_measured_hook_calls_(0)
 {
 }
 
 Profiler::~Profiler() {
-  for (std::set<Function*>::const_iterator iterator = functions_.begin();
-       iterator != functions_.end(); ++iterator) {
-    delete *iterator;
+}
+
+void Profiler::SymbolizeFunctions() {
+  for (std::size_t i = 0; i < functions_.size(); i++) {
+    functions_.Get(i)->Symbolize(amx_, debug_info_, &strings_);
+  }
+  stats_.native_call_sites()->Symbolize(debug_info_, &strings_);
+}
+
+bool Profiler::TrackNativeArgument(const char *native_name, int position) {
+  NativeTableIndex index = FindNative(amx_, native_name);
+  if (index < 0 || position < 1) {
+    return false;
+  }
+  if (!stats_.native_argument_values()->Track(index, position)) {
+    return false;
+  }
+  SetFeature(FEATURE_NATIVE_ARGUMENT_VALUES, true);
+  return true;
+}
+
+void Profiler::Allocate() {
+  native_call_history_.Allocate();
+  stats_.native_call_sites()->Allocate();
+  call_stack_.Reserve(kReservedCallDepth);
+}
+
+void Profiler::CalibrateOverhead() {
+  // These don't need to be valid, the profiler never looks them up.
+  const Address kPublicAddress = 1;
+  const Address kFunctionAddress = 2;
+  const Address kPublicFrame = 1024;
+  const Address kFunctionFrame = kPublicFrame - 4 * sizeof(cell);
+
+  for (int i = 0; i < kCalibrationRounds; i++) {
+    Profiler profiler(amx_, (features_ & FEATURE_CALL_GRAPH) != 0);
+    profiler.ProcessPublicEnter(0, kPublicAddress, kPublicFrame, Clock::Now());
+
+    TimePoint start = Clock::Now();
+    for (int j = 0; j < kCalibrationCalls; j++) {
+      profiler.ProcessBreak(kFunctionFrame, kFunctionAddress, Clock::Now());
+      profiler.ProcessBreak(kPublicFrame, 0, Clock::Now());
+    }
+    Nanoseconds time = Clock::Now() - start;
+
+    profiler.ProcessPublicLeave(kPublicAddress, Clock::Now());
+
+    const FunctionStatistics *fn_stats =
+      profiler.stats_.GetFunctionStatistics(kFunctionAddress);
+    Nanoseconds total = Nanoseconds(time.count() / kCalibrationCalls);
+    Nanoseconds inner =
+      Nanoseconds(fn_stats->total_time().count() / kCalibrationCalls);
+
+    if (i == 0 || total < call_overhead_) {
+      set_call_overhead(inner, total);
+    }
   }
 }
 
-int Profiler::DebugHook(AMX_DEBUG debug) {
+Nanoseconds Profiler::GetHookTime() const {
+  if (num_measured_hook_calls_ == 0) {
+    return Nanoseconds();
+  }
+  return Nanoseconds(measured_hook_time_.count()
+                     * static_cast<double>(num_hook_calls_)
+                     / static_cast<double>(num_measured_hook_calls_));
+}
+
+template<int Features>
+int Profiler::DebugHook(AMX_DEBUG debug) AMXPROF_NOEXCEPT_DEF {
+  if (!normal_functions_enabled_) {
+    return debug != 0 ? debug(amx_) : AMX_ERR_NONE;
+  }
+
+  Address frm = amx_->frm;
   Address prev_frame = call_stack_.is_empty()
     ? amx_->stp
-    : prev_frame = call_stack_.top()->frame();
-
-  if (amx_->frm < prev_frame) {
-    if (prev_frame != amx_->frm) {
-      Address address = GetCalleeAddress(amx_, amx_->frm);
-      if (address != 0) {
-        Function *fn = stats_.GetFunction(address);
-        if (fn == 0) {
-          fn = Function::Normal(address, debug_info_);
-          functions_.insert(fn);
-          stats_.AddFunction(fn);
-        }
-        EnterFunction(address, amx_->frm);
-      }
+    : call_stack_.top()->frame();
+
+  // The hook runs for every statement, so those that are only a new
+  // statement in the same function are sampled too. Otherwise their cost
+  // would be missing from the estimate.
+  bool measure = BeginHookCall();
+  TimePoint now;
+  if (measure) {
+    now = Clock::Now();
+  }
+
+  // Most of the time the debug hook is called for a new statement in the
+  // same function, which doesn't need any further processing.
+  if (frm != prev_frame) {
+    Address callee = 0;
+    if (frm < prev_frame) {
+      callee = GetCalleeAddress(amx_, frm);
     }
-  } else if (amx_->frm > prev_frame) {
-    if (call_stack_.top()->function()->type() == Function::NORMAL) {
-      LeaveFunction(0, amx_->frm);
+    if (!measure && NeedsTime(frm, callee)) {
+      now = Clock::Now();
+    }
+    if ((Features & FEATURE_RECORD_EVENTS) && event_recorder_ != 0) {
+      event_recorder_->RecordBreak(frm, callee, now);
     }
+    ProcessBreak<Features>(frm, callee, now);
+  }
+
+  if (Features & FEATURE_MEMORY) {
+    ObserveMemory();
+  }
+
+  if (measure) {
+    EndHookCall(now);
   }
 
   if (debug != 0) {
@@ -76,25 +194,100 @@ int Profiler::DebugHook(AMX_DEBUG debug) {
   return AMX_ERR_NONE;
 }
 
-int Profiler::CallbackHook(cell index, cell *result, cell *params, AMX_CALLBACK callback) {
+template<int Features>
+int Profiler::CallbackHook(cell index,
+                           cell *result,
+                           cell *params,
+                           AMX_CALLBACK callback) AMXPROF_NOEXCEPT_DEF {
   if (callback == 0) {
     callback = ::amx_Callback;
   }
 
   if (index >= 0) {
     Address address = GetNativeAddress(amx_, index);
+    NativeArgumentValues::TrackedArgument *tracked_args = 0;
+    cell tracked_values[NativeArgumentValues::kMaxArgumentsPerNative];
+    int num_args = 0;
+    TimePoint enter_time;
+    TimePoint enter_cpu_time;
     if (address != 0) {
-      Function *fn = stats_.GetFunction(address);
-      if (fn == 0) {
-        fn = Function::Native(amx_, index);
-        functions_.insert(fn);
-        stats_.AddFunction(fn);
+      if ((Features & FEATURE_RECORD_EVENTS)
+          && event_recorder_ != 0
+          && stats_.GetFunction(address) == 0) {
+        event_recorder_->RecordName(Function::NATIVE, index,
+                                    GetNativeName(amx_, index));
+      }
+      Address call_site = GetNativeCallSite(amx_);
+      num_args = static_cast<int>(params[0] / sizeof(cell));
+      long payload_size = (Features & FEATURE_NATIVE_PAYLOAD)
+                          ? GetStringArgumentsLength(amx_, params)
+                          : -1;
+      uint32_t args_hash = (Features & FEATURE_REDUNDANT_NATIVES)
+                           ? HashNativeCall(amx_, index, params)
+                           : 0;
+      if (Features & FEATURE_MEMORY) {
+        // Strings passed to natives are copied to the heap by the caller.
+        ObserveMemory();
+      }
+      bool measure = BeginHookCall();
+      TimePoint now = Clock::Now();
+      enter_time = now;
+      if (Features & FEATURE_CPU_TIME) {
+        enter_cpu_time = Clock::ThreadCpuTime();
+      }
+      if ((Features & FEATURE_RECORD_EVENTS) && event_recorder_ != 0) {
+        event_recorder_->RecordNativeEnter(index, address, amx_->frm,
+                                           call_site, num_args, payload_size,
+                                           args_hash, now);
+      }
+      ProcessNativeEnter<Features>(index, address, amx_->frm, call_site,
+                                   num_args, payload_size, args_hash, now);
+      if (Features & FEATURE_NATIVE_ARGUMENT_VALUES) {
+        // The list is ordered by position, so it can stop at the first
+        // argument that wasn't passed.
+        tracked_args = stats_.native_argument_values()->Find(index);
+        int i = 0;
+        for (NativeArgumentValues::TrackedArgument *arg = tracked_args;
+             arg != 0 && arg->position <= num_args;
+             arg = arg->next) {
+          tracked_values[i++] = params[arg->position];
+        }
+      }
+      if (measure) {
+        EndHookCall(now);
       }
-      EnterFunction(address, amx_->frm);
     }
     int error = callback(amx_, index, result, params);
     if (address != 0) {
-      LeaveFunction(address, 0);
+      bool measure = BeginHookCall();
+      Nanoseconds cpu_time;
+      if (Features & FEATURE_CPU_TIME) {
+        cpu_time = Clock::ThreadCpuTime() - enter_cpu_time;
+      }
+      TimePoint now = Clock::Now();
+      if (Features & FEATURE_NATIVE_ARGUMENT_VALUES) {
+        int i = 0;
+        for (NativeArgumentValues::TrackedArgument *arg = tracked_args;
+             arg != 0 && arg->position <= num_args;
+             arg = arg->next) {
+          arg->values.AddCall(tracked_values[i++], now - enter_time);
+        }
+      }
+      if (Features & FEATURE_CPU_TIME) {
+        // The CPU time was read between the two timestamps, so whatever is
+        // left is the time it wasn't running. This replaces the time added
+        // by any publics it called.
+        Nanoseconds off_cpu_time = (now - enter_time) - cpu_time;
+        call_stack_.top()->set_off_cpu_time(
+          off_cpu_time.count() > 0 ? off_cpu_time : Nanoseconds());
+      }
+      if ((Features & FEATURE_RECORD_EVENTS) && event_recorder_ != 0) {
+        event_recorder_->RecordNativeLeave(address, now);
+      }
+      ProcessNativeLeave<Features>(address, now);
+      if (measure) {
+        EndHookCall(now);
+      }
     }
     return error;
   }
@@ -102,6 +295,7 @@ int Profiler::CallbackHook(cell index, cell *result, cell *params, AMX_CALLBACK
   return callback(amx_, index, result, params);
 }
 
+template<int Features>
 int Profiler::ExecHook(cell *retval, int index, AMX_EXEC exec) {
   if (exec == 0) {
     exec = ::amx_Exec;
@@ -110,17 +304,37 @@ int Profiler::ExecHook(cell *retval, int index, AMX_EXEC exec) {
   if (index >= 0 || index == AMX_EXEC_MAIN) {
     Address address = GetPublicAddress(amx_, index);
     if (address != 0) {
-      Function *fn = stats_.GetFunction(address);
-      if (fn == 0) {
-        fn = Function::Public(amx_, index);
-        functions_.insert(fn);
-        stats_.AddFunction(fn);
+      Address frame = amx_->stk - 3 * sizeof(cell);
+      if ((Features & FEATURE_RECORD_EVENTS)
+          && event_recorder_ != 0
+          && stats_.GetFunction(address) == 0) {
+        event_recorder_->RecordName(Function::PUBLIC, index,
+                                    GetPublicName(amx_, index));
+      }
+      bool measure = BeginHookCall();
+      TimePoint now = Clock::Now();
+      if ((Features & FEATURE_RECORD_EVENTS) && event_recorder_ != 0) {
+        event_recorder_->RecordPublicEnter(index, address, frame, now);
+      }
+      ProcessPublicEnter<Features>(index, address, frame, now);
+      if (Features & FEATURE_MEMORY) {
+        ObserveMemory();
+      }
+      if (measure) {
+        EndHookCall(now);
       }
-      EnterFunction(address, amx_->stk - 3 * sizeof(cell));
     }
     int error = exec(amx_, retval, index);
     if (address != 0) {
-      LeaveFunction(address, 0);
+      bool measure = BeginHookCall();
+      TimePoint now = Clock::Now();
+      if ((Features & FEATURE_RECORD_EVENTS) && event_recorder_ != 0) {
+        event_recorder_->RecordPublicLeave(address, now);
+      }
+      ProcessPublicLeave<Features>(address, now);
+      if (measure) {
+        EndHookCall(now);
+      }
     }
     return error;
   }
@@ -128,49 +342,172 @@ int Profiler::ExecHook(cell *retval, int index, AMX_EXEC exec) {
   return exec(amx_, retval, index);
 }
 
-void Profiler::EnterFunction(Address address, Address frame) {
-  assert(address != 0);
+template<int Features>
+void Profiler::ProcessBreak(Address frm, Address callee, TimePoint time) {
+  if (call_stack_.is_empty() || frm < call_stack_.top()->frame()) {
+    if (callee != 0) {
+      FunctionStatistics *fn_stats = stats_.GetFunctionStatistics(callee);
+      if (fn_stats == 0) {
+        fn_stats = AddFunction(Function::Normal(callee));
+      }
+      EnterFunction<Features>(fn_stats, frm, time);
+    }
+  } else if (frm > call_stack_.top()->frame()) {
+    if (call_stack_.top()->function()->type() == Function::NORMAL) {
+      LeaveFunction<Features>(0, frm, time);
+    }
+  }
+}
+
+template<int Features>
+void Profiler::ProcessNativeEnter(NativeTableIndex index,
+                                  Address address,
+                                  Address frm,
+                                  Address call_site,
+                                  int num_args,
+                                  long payload_size,
+                                  uint32_t args_hash,
+                                  TimePoint time) {
+  FunctionStatistics *fn_stats = stats_.GetFunctionStatistics(address);
+  if (fn_stats == 0) {
+    fn_stats = AddFunction(Function::Native(address, index));
+  }
+  EnterFunction<Features>(fn_stats, frm, time);
+  call_stack_.top()->set_call_site(call_site);
+  call_stack_.top()->set_arguments(num_args, payload_size);
+  call_stack_.top()->set_args_hash(args_hash);
+}
+
+template<int Features>
+void Profiler::ProcessNativeLeave(Address address, TimePoint time) {
+  LeaveFunction<Features>(address, 0, time);
+}
 
+template<int Features>
+void Profiler::ProcessPublicEnter(PublicTableIndex index,
+                                  Address address,
+                                  Address frame,
+                                  TimePoint time) {
   FunctionStatistics *fn_stats = stats_.GetFunctionStatistics(address);
+  if (fn_stats == 0) {
+    fn_stats = AddFunction(Function::Public(address, index));
+  }
+  EnterFunction<Features>(fn_stats, frame, time);
+}
+
+template<int Features>
+void Profiler::ProcessPublicLeave(Address address, TimePoint time) {
+  LeaveFunction<Features>(address, 0, time);
+}
+
+template<int Features>
+void Profiler::EnterFunction(FunctionStatistics *fn_stats,
+                             Address frame,
+                             TimePoint time) {
   assert(fn_stats != 0);
 
   fn_stats->AdjustNumCalls(1);
+  if (sample_interval_ > 1) {
+    UpdateSampling(fn_stats);
+  }
 
-  call_stack_.Push(fn_stats->function(), frame);
-  if (call_graph_enabled_) {
+  call_stack_.Push(fn_stats->function(), frame, time, fn_stats->SampleCall());
+  if (call_stack_.top()->is_recursive() && !fn_stats->is_recursive()) {
+    // Untimed recursive calls would mess up the shadow counters, so stop
+    // sampling such functions.
+    fn_stats->set_recursive(true);
+    fn_stats->set_sample_interval(1);
+  }
+  if (Features & FEATURE_CALL_GRAPH) {
     call_graph_.PushCall(fn_stats);
   }
 }
 
-void Profiler::LeaveFunction(Address address, Address frame) {
+template<int Features>
+void Profiler::LeaveFunction(Address address, Address frame, TimePoint time) {
   assert(!call_stack_.is_empty());
   assert(address == 0 || stats_.GetFunction(address) != 0);
 
   while (!call_stack_.is_empty()) {
-    FunctionCall call = call_stack_.Pop();
+    FunctionCall call = call_stack_.Pop(time);
     FunctionCall *next_call = call_stack_.is_empty() ? 0 : call_stack_.top();
 
-    FunctionStatistics *fn_stats =
-      stats_.GetFunctionStatistics(call.function()->address());
+    FunctionStatistics *fn_stats = call.function()->statistics();
     assert(fn_stats != 0);
 
-    fn_stats->AdjustSelfTime(call.timer()->self_time());
-    fn_stats->AdjustTotalTime(call.timer()->total_time());
+    if (call.is_timed()) {
+      fn_stats->AdjustSelfTime(call.timer()->self_time());
+      fn_stats->AdjustTotalTime(call.timer()->total_time());
 
-    Nanoseconds total_time = call.timer()->latest_total_time();
-    if (total_time > fn_stats->worst_total_time()) {
-      fn_stats->set_worst_total_time(total_time);
-    }
+      Nanoseconds total_time = call.timer()->latest_total_time();
+      if (total_time > fn_stats->worst_total_time()) {
+        fn_stats->set_worst_total_time(total_time);
+      }
 
-    Nanoseconds self_time = call.timer()->latest_self_time();
-    if (self_time > fn_stats->worst_self_time()) {
-      fn_stats->set_worst_self_time(self_time);
+      Nanoseconds self_time = call.timer()->latest_self_time();
+      if (self_time > fn_stats->worst_self_time()) {
+        fn_stats->set_worst_self_time(self_time);
+      }
+
+      fn_stats->AddSample(self_time);
+
+      // Hooks for child calls run partly inside the child's own timer and
+      // partly outside of it, in this call's self time.
+      Nanoseconds outer_call_overhead = call_overhead_ - inner_call_overhead_;
+      fn_stats->AdjustOverhead(
+        inner_call_overhead_
+          + Nanoseconds(outer_call_overhead.count() * call.num_child_calls()),
+        inner_call_overhead_
+          + Nanoseconds(call_overhead_.count() * call.num_descendant_calls()));
+    } else if (next_call != 0) {
+      // Charge the caller with the average time of this function instead,
+      // otherwise it would count as the caller's own time.
+      next_call->timer()->AdjustChildTime(fn_stats->average_total_time());
     }
 
-    if (call_graph_enabled_) {
+    if (Features & FEATURE_CALL_GRAPH) {
       call_graph_.PopCall();
     }
 
+    if (Features & FEATURE_CPU_TIME) {
+      if (!call.is_recursive()) {
+        fn_stats->AdjustOffCpuTime(call.off_cpu_time());
+      }
+      if (next_call != 0) {
+        next_call->AddChildOffCpuTime(call);
+      }
+    }
+
+    if (Features & FEATURE_MEMORY) {
+      fn_stats->AddMemoryUsage(call.stack_usage(), call.heap_usage());
+      if (next_call != 0) {
+        next_call->AddChildMemory(call);
+      }
+    }
+
+    NativeArgumentStatistics *args = fn_stats->argument_statistics();
+    if (args != 0 && call.is_timed()) {
+      args->AddCall(call.num_args(),
+                    call.payload_size(),
+                    call.timer()->latest_total_time());
+    }
+
+    if (call.call_site() != 0 && next_call != 0) {
+      long repeats = native_call_history_.AddCall(call.args_hash());
+      stats_.native_call_sites()->AddCall(call.call_site(),
+                                          call.function(),
+                                          next_call->function(),
+                                          call.timer()->total_time(),
+                                          repeats);
+    }
+
+    if (next_call != 0) {
+      next_call->AddChildCall(call);
+    } else {
+      script_time_ += call.timer()->total_time();
+      native_call_history_.Clear();
+    }
+
     if (call.function()->address() == address
         || (frame != 0 && next_call != 0 && next_call->frame() >= frame)) {
       break;
@@ -178,4 +515,204 @@ void Profiler::LeaveFunction(Address address, Address frame) {
   }
 }
 
+template<>
+void Profiler::FillHookTables<-1>(HookTable *) {
+}
+
+template<int Features>
+void Profiler::FillHookTables(HookTable *tables) {
+  const int kNonNativeFeatures = Features & NON_NATIVE_FEATURES;
+  tables[Features].debug_hook = &Profiler::DebugHook<kNonNativeFeatures>;
+  tables[Features].callback_hook = &Profiler::CallbackHook<Features>;
+  tables[Features].exec_hook = &Profiler::ExecHook<kNonNativeFeatures>;
+  FillHookTables<Features - 1>(tables);
+}
+
+// static
+const Profiler::HookTable *Profiler::GetHookTable(int features) {
+  static HookTable tables[NUM_FEATURE_COMBINATIONS];
+  if (tables[0].debug_hook == 0) {
+    FillHookTables<NUM_FEATURE_COMBINATIONS - 1>(tables);
+  }
+  return &tables[features];
+}
+
+int Profiler::DebugHook(AMX_DEBUG debug) AMXPROF_NOEXCEPT_DEF {
+  return (this->*hook_table_->debug_hook)(debug);
+}
+
+int Profiler::CallbackHook(cell index,
+                           cell *result,
+                           cell *params,
+                           AMX_CALLBACK callback) AMXPROF_NOEXCEPT_DEF {
+  return (this->*hook_table_->callback_hook)(index, result, params, callback);
+}
+
+int Profiler::ExecHook(cell *retval, int index, AMX_EXEC exec) {
+  return (this->*hook_table_->exec_hook)(retval, index, exec);
+}
+
+// Recording is done by the hooks, these only care about the call graph.
+
+void Profiler::ProcessBreak(Address frm, Address callee, TimePoint time) {
+  if (features_ & FEATURE_CALL_GRAPH) {
+    ProcessBreak<kCallGraph>(frm, callee, time);
+  } else {
+    ProcessBreak<kNoFeatures>(frm, callee, time);
+  }
+}
+
+void Profiler::ProcessNativeEnter(NativeTableIndex index,
+                                  Address address,
+                                  Address frm,
+                                  Address call_site,
+                                  int num_args,
+                                  long payload_size,
+                                  uint32_t args_hash,
+                                  TimePoint time) {
+  if (features_ & FEATURE_CALL_GRAPH) {
+    ProcessNativeEnter<kCallGraph>(index, address, frm, call_site,
+                                   num_args, payload_size, args_hash, time);
+  } else {
+    ProcessNativeEnter<kNoFeatures>(index, address, frm, call_site,
+                                    num_args, payload_size, args_hash, time);
+  }
+}
+
+void Profiler::ProcessNativeLeave(Address address, TimePoint time) {
+  if (features_ & FEATURE_CALL_GRAPH) {
+    ProcessNativeLeave<kCallGraph>(address, time);
+  } else {
+    ProcessNativeLeave<kNoFeatures>(address, time);
+  }
+}
+
+void Profiler::ProcessPublicEnter(PublicTableIndex index,
+                                  Address address,
+                                  Address frame,
+                                  TimePoint time) {
+  if (features_ & FEATURE_CALL_GRAPH) {
+    ProcessPublicEnter<kCallGraph>(index, address, frame, time);
+  } else {
+    ProcessPublicEnter<kNoFeatures>(index, address, frame, time);
+  }
+}
+
+void Profiler::ProcessPublicLeave(Address address, TimePoint time) {
+  if (features_ & FEATURE_CALL_GRAPH) {
+    ProcessPublicLeave<kCallGraph>(address, time);
+  } else {
+    ProcessPublicLeave<kNoFeatures>(address, time);
+  }
+}
+
+void Profiler::ObserveMemory() AMXPROF_NOEXCEPT_DEF {
+  if (call_stack_.is_empty()) {
+    return;
+  }
+  Address stk = amx_->stk;
+  Address hea = amx_->hea;
+  call_stack_.top()->ObserveMemory(stk, hea);
+
+  long stack_usage = static_cast<long>(amx_->stp - stk);
+  if (stack_usage > stats_.peak_stack()->usage) {
+    RecordMemoryPeak(stats_.peak_stack(), stack_usage);
+  }
+  long heap_usage = static_cast<long>(hea - amx_->hlw);
+  if (heap_usage > stats_.peak_heap()->usage) {
+    RecordMemoryPeak(stats_.peak_heap(), heap_usage);
+  }
+}
+
+void Profiler::RecordMemoryPeak(MemoryPeak *peak,
+                                long usage) AMXPROF_NOEXCEPT_DEF {
+  peak->usage = usage;
+  peak->depth = 0;
+  peak->call_stack.clear();
+  for (const FunctionCall *call = call_stack_.top();
+       call != 0; call = call->parent()) {
+    if (peak->call_stack.size() < MemoryPeak::kMaxCallStackDepth) {
+      peak->call_stack.push_back(call->function());
+    }
+    peak->depth++;
+  }
+  std::reverse(peak->call_stack.begin(), peak->call_stack.end());
+}
+
+bool Profiler::NeedsTime(Address frm,
+                         Address callee) const AMXPROF_NOEXCEPT_DEF {
+  if (sample_interval_ <= 1 || event_recorder_ != 0) {
+    return true;
+  }
+  if (callee != 0) {
+    const FunctionStatistics *fn_stats = stats_.GetFunctionStatistics(callee);
+    return fn_stats == 0 || fn_stats->IsNextCallTimed();
+  }
+  if (call_stack_.is_empty()) {
+    return true;
+  }
+  const FunctionCall *call = call_stack_.top();
+  if (call->is_timed()) {
+    return true;
+  }
+  // More than one call may be left at once, see LeaveFunction().
+  const FunctionCall *next_call = call->parent();
+  return next_call != 0 && next_call->frame() < frm;
+}
+
+FunctionStatistics *Profiler::AddFunction(const Function &fn) {
+  return stats_.AddFunction(functions_.Create(fn));
+}
+
+bool Profiler::BeginHookCall() AMXPROF_NOEXCEPT_DEF {
+  num_hook_calls_++;
+  if (--hook_countdown_ > 0) {
+    return false;
+  }
+  hook_countdown_ = kHookMeasureInterval;
+  return true;
+}
+
+void Profiler::EndHookCall(TimePoint start) AMXPROF_NOEXCEPT_DEF {
+  measured_hook_time_ += Clock::Now() - start;
+  num_measured_hook_calls_++;
+}
+
+void Profiler::ResetSampling() {
+  for (std::size_t i = 0; i < functions_.size(); i++) {
+    FunctionStatistics *fn_stats = functions_.Get(i)->statistics();
+    if (fn_stats != 0 && fn_stats->sample_interval() > 1) {
+      fn_stats->set_sample_interval(1);
+    }
+  }
+}
+
+void Profiler::UpdateSampling(FunctionStatistics *fn_stats) {
+  long num_calls = fn_stats->num_calls();
+  if (fn_stats->sample_interval() > 1
+      || fn_stats->is_recursive()
+      || num_calls < sample_min_calls_
+      || (num_calls - sample_min_calls_) % kSamplingCheckInterval != 0) {
+    return;
+  }
+  if (fn_stats->function()->type() == Function::NORMAL
+      && fn_stats->average_self_time() < sample_max_self_time_) {
+    fn_stats->set_sample_interval(sample_interval_);
+  }
+}
+
+// The hooks are called from other files.
+#define AMXPROF_INSTANTIATE_HOOKS(Features) \
+  template int Profiler::DebugHook<Features>(AMX_DEBUG) AMXPROF_NOEXCEPT_DEF; \
+  template int Profiler::ExecHook<Features>(cell*, int, AMX_EXEC);
+#define AMXPROF_INSTANTIATE_CALLBACK_HOOK(Features) \
+  template int Profiler::CallbackHook<Features>( \
+    cell, cell*, cell*, AMX_CALLBACK) AMXPROF_NOEXCEPT_DEF;
+
+AMXPROF_FOR_EACH_NON_NATIVE_FEATURES(AMXPROF_INSTANTIATE_HOOKS)
+AMXPROF_FOR_EACH_FEATURES(AMXPROF_INSTANTIATE_CALLBACK_HOOK)
+
+#undef AMXPROF_INSTANTIATE_HOOKS
+#undef AMXPROF_INSTANTIATE_CALLBACK_HOOK
+
 } // namespace amxprof
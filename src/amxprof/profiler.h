@@ -25,19 +25,56 @@
 #ifndef AMXPROF_PROFILER_H
 #define AMXPROF_PROFILER_H
 
-#include <set>
 #include "amx_types.h"
+#include "arena.h"
 #include "call_graph.h"
 #include "call_stack.h"
+#include "clock.h"
 #include "debug_info.h"
 #include "function_statistics.h"
 #include "macros.h"
+#include "native_call_history.h"
 #include "statistics.h"
+#include "string_pool.h"
 
 namespace amxprof {
 
+class EventRecorder;
+
 class Profiler {
  public:
+  // Optional parts of the hooks. Each hook is compiled for every
+  // combination of these, so the features that are off cost nothing.
+  enum Feature {
+    FEATURE_CALL_GRAPH = 1 << 0,
+    FEATURE_RECORD_EVENTS = 1 << 1,
+    // Track the stack and heap usage of each function. This looks at the
+    // AMX on every debug hook call.
+    FEATURE_MEMORY = 1 << 2,
+    // Split times into time on and off the CPU. This reads the thread's
+    // CPU time around every native call.
+    FEATURE_CPU_TIME = 1 << 3,
+    // Measure the length of string arguments passed to natives (see
+    // GetStringArgumentsLength()). This looks at every argument.
+    FEATURE_NATIVE_PAYLOAD = 1 << 4,
+    // Hash each native call together with its arguments, so that calls
+    // repeating an earlier one within the same top-level call are counted
+    // per call site (see NativeCallSite).
+    FEATURE_REDUNDANT_NATIVES = 1 << 5,
+    // Find the values of native arguments that take the most time, see
+    // TrackNativeArgument().
+    FEATURE_NATIVE_ARGUMENT_VALUES = 1 << 6,
+    // Number of combinations of the above.
+    NUM_FEATURE_COMBINATIONS = 1 << 7,
+    // Features that only change what the callback hook does before a
+    // native is called. The debug and exec hooks are compiled without
+    // them, so those only come in NON_NATIVE_FEATURES + 1 variants.
+    NATIVE_FEATURES = FEATURE_NATIVE_PAYLOAD
+                      | FEATURE_REDUNDANT_NATIVES
+                      | FEATURE_NATIVE_ARGUMENT_VALUES,
+    NON_NATIVE_FEATURES = FEATURE_NATIVE_PAYLOAD - 1
+  };
+
   Profiler(AMX *amx, bool enable_call_graph = false);
   ~Profiler();
 
@@ -47,46 +84,294 @@ class Profiler {
   const CallStack *call_stack() const { return &call_stack_; }
   const CallGraph *call_graph() const { return &call_graph_; }
 
+  // The features currently in use.
+  int features() const {
+    return event_recorder_ != 0
+      ? features_ | FEATURE_RECORD_EVENTS
+      : features_;
+  }
+
   // Debug info is needed for function names. If not set the functions
   // will be shown as "unknown@XXXXXXXX" where XXXXXXXX is the AMX code
   // offset (except for public functions, whose names are duplicated
   // in the AMX name table).
-  void set_debug_info(DebugInfo *debug_info) {
+  void set_debug_info(const DebugInfo *debug_info) {
     debug_info_ = debug_info;
   }
 
+  // If set, the inputs of all hooks are written to the recorder so that
+  // they can be replayed later (see EventReplayer).
+  void set_event_recorder(EventRecorder *recorder) {
+    event_recorder_ = recorder;
+    UpdateHookTable();
+  }
+
+  // Once a normal function has been called at least min_calls times and
+  // its average self time is below max_self_time, only one in interval
+  // of its calls is timed. Its times are then extrapolated from those
+  // calls. This greatly reduces the overhead of profiling tiny functions
+  // that are called very often. An interval of 0 or 1 disables sampling.
+  void EnableSampling(long interval,
+                      long min_calls,
+                      Nanoseconds max_self_time) {
+    sample_interval_ = interval;
+    sample_min_calls_ = min_calls;
+    sample_max_self_time_ = max_self_time;
+  }
+
+  // Times every call of the functions that are sampled again. They are
+  // picked for sampling anew with the settings from EnableSampling() as
+  // they keep being called. Their times stay extrapolated from the calls
+  // that were timed.
+  void ResetSampling();
+
+  // Enables FEATURE_NATIVE_PAYLOAD. Only call this when the call stack is
+  // empty.
+  bool native_payload_enabled() const {
+    return (features_ & FEATURE_NATIVE_PAYLOAD) != 0;
+  }
+  void set_native_payload_enabled(bool enabled) {
+    SetFeature(FEATURE_NATIVE_PAYLOAD, enabled);
+  }
+
+  // Enables FEATURE_REDUNDANT_NATIVES. Only call this when the call stack
+  // is empty.
+  bool redundant_calls_enabled() const {
+    return (features_ & FEATURE_REDUNDANT_NATIVES) != 0;
+  }
+  void set_redundant_calls_enabled(bool enabled) {
+    SetFeature(FEATURE_REDUNDANT_NATIVES, enabled);
+  }
+
+  // Enables FEATURE_MEMORY. Only call this when the call stack is empty.
+  // Memory usage is read from the AMX by the hooks, so it's not part of
+  // recorded events.
+  bool memory_tracking_enabled() const {
+    return (features_ & FEATURE_MEMORY) != 0;
+  }
+  void set_memory_tracking_enabled(bool enabled) {
+    SetFeature(FEATURE_MEMORY, enabled);
+  }
+
+  // Enables FEATURE_CPU_TIME. Only call this when the call stack is empty.
+  // The time each native spent blocked is added up per function and its
+  // callers (see FunctionStatistics::off_cpu_time()). Script code can't
+  // block by itself, so natives are the only place to look.
+  //
+  // Like argument values this is not part of recorded events.
+  bool cpu_time_enabled() const {
+    return (features_ & FEATURE_CPU_TIME) != 0;
+  }
+  void set_cpu_time_enabled(bool enabled) {
+    SetFeature(FEATURE_CPU_TIME, enabled);
+  }
+
+  // Finds the values of the given argument (starting from 1) of a native
+  // that take the most time. Returns false if the script doesn't use the
+  // native, the argument is already tracked or the native has too many
+  // tracked arguments (see NativeArgumentValues::kMaxArgumentsPerNative).
+  // Call this before profiling starts. The first tracked argument enables
+  // FEATURE_NATIVE_ARGUMENT_VALUES.
+  //
+  // This is done by the callback hook, so unlike other statistics it's
+  // not part of recorded events.
+  bool TrackNativeArgument(const char *native_name, int position);
+  NativeArgumentValues *native_argument_values() {
+    return stats_.native_argument_values();
+  }
+
+  // Allocates the tables used by the hooks, which never allocate on their
+  // own except when they see a new function or a new maximum call depth.
+  // Call this before profiling starts; native call sites and redundant
+  // calls seen before it are only counted as dropped.
+  void Allocate();
+
+  // Measures how much time profiling adds to a function call by running
+  // empty calls through the profiler. This is used to compute compensated
+  // times (see FunctionStatistics). Call it before profiling starts.
+  void CalibrateOverhead();
+
+  // The part of the overhead that is seen by the called function's own
+  // timer, and the whole overhead of a call including both hooks.
+  Nanoseconds inner_call_overhead() const { return inner_call_overhead_; }
+  Nanoseconds call_overhead() const { return call_overhead_; }
+
+  void set_call_overhead(Nanoseconds inner, Nanoseconds total) {
+    inner_call_overhead_ = inner;
+    call_overhead_ = total;
+  }
+
+  // Turns profiling of normal (non-public) functions on and off. Only
+  // call this when the call stack is empty.
+  bool normal_functions_enabled() const { return normal_functions_enabled_; }
+  void set_normal_functions_enabled(bool enabled) {
+    normal_functions_enabled_ = enabled;
+  }
+
+  // Time spent in top-level calls, i.e. running the script, including
+  // the time spent in the hooks.
+  Nanoseconds script_time() const { return script_time_; }
+
+  // Estimated time spent in the hooks. Only a fraction of hook calls is
+  // actually measured.
+  Nanoseconds GetHookTime() const;
+
+  // Holds the names of all functions and their source files.
+  StringPool *strings() { return &strings_; }
+
+  // Resolves names of all functions and native call sites seen so far.
+  // Call this before writing statistics or the call graph.
+  void SymbolizeFunctions();
+
  public:
   // This method should be called from within your AMX debug hook (see
   // amx_SetDebugHook). It collects statistics for ordinary functions.
-  int DebugHook(AMX_DEBUG debug = 0);
+  int DebugHook(AMX_DEBUG debug = 0) AMXPROF_NOEXCEPT;
 
   // This method should be called instead of amx_Callback().
   // It collects statistics for native functions.
   int CallbackHook(cell index,
                    cell *result,
                    cell *params,
-                   AMX_CALLBACK callback = 0);
+                   AMX_CALLBACK callback = 0) AMXPROF_NOEXCEPT;
 
   // This method should be called instead of amx_Exec().
   // It collects statistics for public functions.
   int ExecHook(cell *retval, int index, AMX_EXEC exec = 0);
 
+  // Same as above but only with the given features (a combination of
+  // Feature values), so they don't need to check features() on every
+  // call. They must match features(), except that FEATURE_RECORD_EVENTS
+  // may be set while no recorder is. The debug and exec hooks only exist
+  // for combinations of NON_NATIVE_FEATURES.
+  //
+  // The debug and callback hooks don't throw. Running out of memory while
+  // recording a new function or call is fatal.
+  template<int Features>
+  int DebugHook(AMX_DEBUG debug = 0) AMXPROF_NOEXCEPT;
+  template<int Features>
+  int CallbackHook(cell index,
+                   cell *result,
+                   cell *params,
+                   AMX_CALLBACK callback = 0) AMXPROF_NOEXCEPT;
+  template<int Features>
+  int ExecHook(cell *retval, int index, AMX_EXEC exec = 0);
+
+ public:
+  // The hooks above read what they need from the AMX and pass it on to
+  // these methods along with the current time. They don't touch the AMX
+  // themselves, so recorded events can be processed without one.
+  void ProcessBreak(Address frm, Address callee, TimePoint time);
+  void ProcessNativeEnter(NativeTableIndex index,
+                          Address address,
+                          Address frm,
+                          Address call_site,
+                          int num_args,
+                          long payload_size,
+                          uint32_t args_hash,
+                          TimePoint time);
+  void ProcessNativeLeave(Address address, TimePoint time);
+  void ProcessPublicEnter(PublicTableIndex index,
+                          Address address,
+                          Address frame,
+                          TimePoint time);
+  void ProcessPublicLeave(Address address, TimePoint time);
+
  private:
   Profiler();
 
+  template<int Features>
+  void ProcessBreak(Address frm, Address callee, TimePoint time);
+  template<int Features>
+  void ProcessNativeEnter(NativeTableIndex index,
+                          Address address,
+                          Address frm,
+                          Address call_site,
+                          int num_args,
+                          long payload_size,
+                          uint32_t args_hash,
+                          TimePoint time);
+  template<int Features>
+  void ProcessNativeLeave(Address address, TimePoint time);
+  template<int Features>
+  void ProcessPublicEnter(PublicTableIndex index,
+                          Address address,
+                          Address frame,
+                          TimePoint time);
+  template<int Features>
+  void ProcessPublicLeave(Address address, TimePoint time);
+
   // BeginFunction() and EndFunction() are called when entering
   // a function and returning from it respectively.
-  void EnterFunction(Address address, Address frm);
-  void LeaveFunction(Address address, Address frm);
+  template<int Features>
+  void EnterFunction(FunctionStatistics *fn_stats,
+                     Address frm,
+                     TimePoint time);
+  template<int Features>
+  void LeaveFunction(Address address, Address frm, TimePoint time);
+
+  // Tells whether processing a break needs the current time. It doesn't
+  // when the break only enters or leaves a call that isn't timed.
+  bool NeedsTime(Address frm, Address callee) const AMXPROF_NOEXCEPT;
+
+  // Updates the current call and the script's peak memory usage with the
+  // AMX's stack and heap pointers.
+  void ObserveMemory() AMXPROF_NOEXCEPT;
+  void RecordMemoryPeak(MemoryPeak *peak, long usage) AMXPROF_NOEXCEPT;
+
+  void UpdateSampling(FunctionStatistics *fn_stats);
+
+  // The hooks compiled for one combination of features. The untemplated
+  // hooks call them through hook_table_, the entry for features(), which
+  // is looked up again whenever the features change.
+  struct HookTable {
+    int (Profiler::*debug_hook)(AMX_DEBUG);
+    int (Profiler::*callback_hook)(cell, cell *, cell *, AMX_CALLBACK);
+    int (Profiler::*exec_hook)(cell *, int, AMX_EXEC);
+  };
+  template<int Features>
+  static void FillHookTables(HookTable *tables);
+  static const HookTable *GetHookTable(int features);
+  void UpdateHookTable() { hook_table_ = GetHookTable(features()); }
+
+  void SetFeature(Feature feature, bool enabled) {
+    features_ = enabled ? features_ | feature : features_ & ~feature;
+    UpdateHookTable();
+  }
+
+  // Creates a new function and returns its statistics.
+  FunctionStatistics *AddFunction(const Function &fn);
+
+  // Return true if this hook call should be measured, in which case
+  // EndHookCall() must be called with the time it started.
+  bool BeginHookCall() AMXPROF_NOEXCEPT;
+  void EndHookCall(TimePoint start) AMXPROF_NOEXCEPT;
 
  private:
   AMX *amx_;
-  DebugInfo *debug_info_;
-  bool call_graph_enabled_;
+  const DebugInfo *debug_info_;
+  EventRecorder *event_recorder_;
+  // Features other than FEATURE_RECORD_EVENTS, which is set by having
+  // a recorder.
+  int features_;
+  const HookTable *hook_table_;
+  bool normal_functions_enabled_;
+  long sample_interval_;
+  long sample_min_calls_;
+  Nanoseconds sample_max_self_time_;
+  long hook_countdown_;
+  uint64_t num_hook_calls_;
+  uint64_t num_measured_hook_calls_;
+  Nanoseconds measured_hook_time_;
+  Nanoseconds script_time_;
+  Nanoseconds inner_call_overhead_;
+  Nanoseconds call_overhead_;
   CallStack call_stack_;
   CallGraph call_graph_;
   Statistics stats_;
-  std::set<Function*> functions_;
+  NativeCallHistory native_call_history_;
+  Arena<Function> functions_;
+  StringPool strings_;
 
  private:
   AMXPROF_DISALLOW_COPY_AND_ASSIGN(Profiler);
@@ -94,4 +379,31 @@ class Profiler {
 
 } // namespace amxprof
 
+// Expands M(Features) for every combination of Profiler::Feature values,
+// e.g. to explicitly instantiate the hooks.
+#define AMXPROF_FEATURE_COMBINATIONS_1(M, F) M(F) M((F) | 1)
+#define AMXPROF_FEATURE_COMBINATIONS_2(M, F) \
+  AMXPROF_FEATURE_COMBINATIONS_1(M, F) \
+  AMXPROF_FEATURE_COMBINATIONS_1(M, (F) | 2)
+#define AMXPROF_FEATURE_COMBINATIONS_3(M, F) \
+  AMXPROF_FEATURE_COMBINATIONS_2(M, F) \
+  AMXPROF_FEATURE_COMBINATIONS_2(M, (F) | 4)
+#define AMXPROF_FEATURE_COMBINATIONS_4(M, F) \
+  AMXPROF_FEATURE_COMBINATIONS_3(M, F) \
+  AMXPROF_FEATURE_COMBINATIONS_3(M, (F) | 8)
+#define AMXPROF_FEATURE_COMBINATIONS_5(M, F) \
+  AMXPROF_FEATURE_COMBINATIONS_4(M, F) \
+  AMXPROF_FEATURE_COMBINATIONS_4(M, (F) | 16)
+#define AMXPROF_FEATURE_COMBINATIONS_6(M, F) \
+  AMXPROF_FEATURE_COMBINATIONS_5(M, F) \
+  AMXPROF_FEATURE_COMBINATIONS_5(M, (F) | 32)
+#define AMXPROF_FEATURE_COMBINATIONS_7(M, F) \
+  AMXPROF_FEATURE_COMBINATIONS_6(M, F) \
+  AMXPROF_FEATURE_COMBINATIONS_6(M, (F) | 64)
+#define AMXPROF_FOR_EACH_FEATURES(M) AMXPROF_FEATURE_COMBINATIONS_7(M, 0)
+
+// Same for combinations of Profiler::NON_NATIVE_FEATURES only.
+#define AMXPROF_FOR_EACH_NON_NATIVE_FEATURES(M) \
+  AMXPROF_FEATURE_COMBINATIONS_4(M, 0)
+
 #endif // !AMXPROF_PROFILER_H
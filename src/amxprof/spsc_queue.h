@@ -0,0 +1,121 @@
+// Copyright (c) 2015 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef AMXPROF_SPSC_QUEUE_H
+#define AMXPROF_SPSC_QUEUE_H
+
+#include <cstddef>
+#include <vector>
+#include "atomic.h"
+#include "macros.h"
+
+namespace amxprof {
+
+// A fixed-size ring buffer for passing items from exactly one producer
+// thread to exactly one consumer thread. Neither side ever blocks: pushing
+// to a full queue or popping from an empty one just fails.
+template<typename T>
+class SPSCQueue {
+ public:
+  // The capacity is rounded up to a power of two. The buffer is not
+  // allocated until Allocate() is called.
+  explicit SPSCQueue(std::size_t capacity);
+
+  std::size_t capacity() const { return mask_ + 1; }
+
+  // Must be called before the queue is used, and not while either side
+  // is using it.
+  void Allocate() {
+    if (buffer_.empty()) {
+      buffer_.resize(capacity());
+    }
+  }
+
+  // Producer side.
+  bool TryPush(const T &item);
+
+  // Consumer side.
+  bool TryPop(T *item);
+
+  // Can be called from either side, but is only exact on the consumer
+  // side if the producer is idle (and vice versa).
+  bool is_empty() const {
+    return AtomicLoadAcquire(&head_) == AtomicLoadAcquire(&tail_);
+  }
+
+ private:
+  enum { kCacheLineSize = 64 };
+
+  std::vector<T> buffer_;
+  unsigned long mask_;
+
+  // The producer only writes head_ and the consumer only writes tail_;
+  // keep them on different cache lines so they don't fight over one.
+  char padding1_[kCacheLineSize];
+  volatile unsigned long head_;
+  char padding2_[kCacheLineSize];
+  volatile unsigned long tail_;
+  char padding3_[kCacheLineSize];
+
+ private:
+  AMXPROF_DISALLOW_COPY_AND_ASSIGN(SPSCQueue);
+};
+
+template<typename T>
+SPSCQueue<T>::SPSCQueue(std::size_t capacity)
+ : head_(0),
+   tail_(0)
+{
+  std::size_t size = 1;
+  while (size < capacity) {
+    size <<= 1;
+  }
+  mask_ = static_cast<unsigned long>(size - 1);
+}
+
+template<typename T>
+bool SPSCQueue<T>::TryPush(const T &item) {
+  unsigned long head = head_;
+  if (head - AtomicLoadAcquire(&tail_) > mask_) {
+    return false;
+  }
+  buffer_[head & mask_] = item;
+  AtomicStoreRelease(&head_, head + 1);
+  return true;
+}
+
+template<typename T>
+bool SPSCQueue<T>::TryPop(T *item) {
+  unsigned long tail = tail_;
+  if (AtomicLoadAcquire(&head_) == tail) {
+    return false;
+  }
+  *item = buffer_[tail & mask_];
+  AtomicStoreRelease(&tail_, tail + 1);
+  return true;
+}
+
+} // namespace amxprof
+
+#endif // !AMXPROF_SPSC_QUEUE_H
@@ -28,37 +28,77 @@
 
 namespace amxprof {
 
-Statistics::Statistics() {
-  run_time_counter_.Start();
+Statistics::Statistics()
+ : fn_table_(64)
+{
+  run_time_counter_.Start(Clock::Now());
 }
 
 Statistics::~Statistics() {
-  for (AddressToFuncStatsMap::const_iterator iterator = address_to_fn_stats_.begin();
-       iterator != address_to_fn_stats_.end(); ++iterator)
-  {
-    delete iterator->second;
-  }
 }
 
 Function *Statistics::GetFunction(Address address) {
-  AddressToFuncStatsMap::const_iterator iterator = address_to_fn_stats_.find(address);
-  if (iterator != address_to_fn_stats_.end()) {
-    return iterator->second->function();
+  FunctionStatistics *fn_stats = GetFunctionStatistics(address);
+  if (fn_stats != 0) {
+    return fn_stats->function();
   }
   return 0;
 }
 
-void Statistics::AddFunction(Function *fn) {
-  FunctionStatistics *fn_stats = new FunctionStatistics(fn);
+FunctionStatistics *Statistics::AddFunction(Function *fn) {
+  FunctionStatistics *fn_stats = fn_stats_.Create(fn,
+                                                  call_counters_.Create(),
+                                                  time_counters_.Create(),
+                                                  cpu_counters_.Create());
+  if (fn->type() == Function::NATIVE) {
+    fn_stats->set_argument_statistics(native_args_.Create());
+  }
+  fn->set_statistics(fn_stats);
   address_to_fn_stats_.insert(std::make_pair(fn->address(), fn_stats));
+
+  if (address_to_fn_stats_.size() * 2 > fn_table_.size()) {
+    std::vector<FunctionSlot> old_table(fn_table_.size() * 2);
+    fn_table_.swap(old_table);
+    for (std::size_t i = 0; i < old_table.size(); i++) {
+      if (old_table[i].fn_stats != 0) {
+        InsertSlot(old_table[i].address, old_table[i].fn_stats);
+      }
+    }
+  }
+  InsertSlot(fn->address(), fn_stats);
+  return fn_stats;
 }
 
-FunctionStatistics *Statistics::GetFunctionStatistics(Address address) const {
-  AddressToFuncStatsMap::const_iterator iterator = address_to_fn_stats_.find(address);
-  if (iterator != address_to_fn_stats_.end()) {
-    return iterator->second;
+void Statistics::InsertSlot(Address address, FunctionStatistics *fn_stats) {
+  std::size_t mask = fn_table_.size() - 1;
+  std::size_t i = HashAddress(address) & mask;
+  while (fn_table_[i].fn_stats != 0) {
+    i = (i + 1) & mask;
   }
-  return 0;
+  fn_table_[i].address = address;
+  fn_table_[i].fn_stats = fn_stats;
+}
+
+Nanoseconds Statistics::GetTotalSelfTime() const {
+  Nanoseconds time;
+  for (std::size_t i = 0; i < time_counters_.size(); i++) {
+    const FunctionTimeCounters *times = time_counters_.Get(i);
+    time += FunctionStatistics::Extrapolate(*call_counters_.Get(i),
+                                            times->num_samples,
+                                            times->self_time);
+  }
+  return time;
+}
+
+Nanoseconds Statistics::GetTotalTotalTime() const {
+  Nanoseconds time;
+  for (std::size_t i = 0; i < time_counters_.size(); i++) {
+    const FunctionTimeCounters *times = time_counters_.Get(i);
+    time += FunctionStatistics::Extrapolate(*call_counters_.Get(i),
+                                            times->num_samples,
+                                            times->total_time);
+  }
+  return time;
 }
 
 void Statistics::GetStatistics(std::vector<FunctionStatistics*> &stats) const {
@@ -25,16 +25,38 @@
 #ifndef AMXPROF_STATISTICS_H
 #define AMXPROF_STATISTICS_H
 
+#include <cstddef>
 #include <map>
 #include <vector>
 #include "amx_types.h"
+#include "arena.h"
 #include "duration.h"
+#include "function_statistics.h"
+#include "native_argument_values.h"
+#include "native_arguments.h"
+#include "native_call_sites.h"
 #include "performance_counter.h"
 
 namespace amxprof {
 
 class Function;
-class FunctionStatistics;
+
+// The most stack or heap space the script has used at once and the calls
+// that were running at that moment, outermost first. Only the innermost
+// kMaxCallStackDepth calls are kept, the storage for them is reserved
+// up front because the hooks must not allocate.
+struct MemoryPeak {
+  enum { kMaxCallStackDepth = 64 };
+
+  MemoryPeak() : usage(0), depth(0) {
+    call_stack.reserve(kMaxCallStackDepth);
+  }
+
+  long usage;
+  // The number of calls that were running, may be more than are kept.
+  long depth;
+  std::vector<const Function*> call_stack;
+};
 
 class Statistics {
  public:
@@ -43,18 +65,84 @@ class Statistics {
   Statistics();
   ~Statistics();
 
-  void AddFunction(Function *fn);
+  // Returns the statistics of the new function, which are also available
+  // as fn->statistics().
+  FunctionStatistics *AddFunction(Function *fn);
   Function *GetFunction(Address address);
 
-  FunctionStatistics *GetFunctionStatistics(Address address) const;
+  // This is called by the hooks for every function entry, so it goes
+  // through a hash table rather than the map.
+  FunctionStatistics *GetFunctionStatistics(Address address) const {
+    std::size_t mask = fn_table_.size() - 1;
+    for (std::size_t i = HashAddress(address) & mask;; i = (i + 1) & mask) {
+      const FunctionSlot &slot = fn_table_[i];
+      if (slot.fn_stats == 0 || slot.address == address) {
+        return slot.fn_stats;
+      }
+    }
+  }
+
   void GetStatistics(std::vector<FunctionStatistics*> &stats) const;
 
+  // Sums of FunctionStatistics::self_time() and total_time() over all
+  // functions.
+  Nanoseconds GetTotalSelfTime() const;
+  Nanoseconds GetTotalTotalTime() const;
+
+  NativeCallSites *native_call_sites() { return &native_call_sites_; }
+  const NativeCallSites *native_call_sites() const {
+    return &native_call_sites_;
+  }
+
+  // Updated by the callback hook itself, see Profiler::TrackNativeArgument().
+  NativeArgumentValues *native_argument_values() {
+    return &native_argument_values_;
+  }
+  const NativeArgumentValues *native_argument_values() const {
+    return &native_argument_values_;
+  }
+
+  // Only tracked with Profiler::FEATURE_MEMORY.
+  MemoryPeak *peak_stack() { return &peak_stack_; }
+  const MemoryPeak *peak_stack() const { return &peak_stack_; }
+  MemoryPeak *peak_heap() { return &peak_heap_; }
+  const MemoryPeak *peak_heap() const { return &peak_heap_; }
+
   Nanoseconds GetTotalRunTime() const {
     return run_time_counter_.QueryTotalTime();
   }
 
+ private:
+  struct FunctionSlot {
+    FunctionSlot() : address(0), fn_stats(0) {}
+
+    Address address;
+    FunctionStatistics *fn_stats;
+  };
+
+  static std::size_t HashAddress(Address address) {
+    return static_cast<std::size_t>((address >> 2) * 2654435761u);
+  }
+
+  void InsertSlot(Address address, FunctionStatistics *fn_stats);
+
  private:
   PerformanceCounter run_time_counter_;
+  // Counters of the i-th function are at index i. Calls and returns only
+  // touch their own arrays, and the totals above don't need to go through
+  // the map.
+  Arena<FunctionCallCounters> call_counters_;
+  Arena<FunctionTimeCounters> time_counters_;
+  Arena<FunctionCpuCounters> cpu_counters_;
+  Arena<FunctionStatistics> fn_stats_;
+  Arena<NativeArgumentStatistics, 16> native_args_;
+  NativeCallSites native_call_sites_;
+  NativeArgumentValues native_argument_values_;
+  MemoryPeak peak_stack_;
+  MemoryPeak peak_heap_;
+  // Open addressing with linear probing, at most half full.
+  std::vector<FunctionSlot> fn_table_;
+  // Keeps the functions ordered by address for GetStatistics().
   AddressToFuncStatsMap address_to_fn_stats_;
 };
 
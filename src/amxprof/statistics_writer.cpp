@@ -32,7 +32,10 @@ namespace amxprof {
 StatisticsWriter::StatisticsWriter()
  : stream_(0),
    print_date_(false),
-   print_run_time_(false)
+   print_run_time_(false),
+   print_compensated_times_(false),
+   print_memory_usage_(false),
+   print_cpu_time_(false)
 {
 }
 
@@ -51,11 +51,33 @@ class StatisticsWriter {
   bool print_run_time() const { return print_run_time_; }
   void set_print_run_time(bool print_run_time) { print_run_time_ = print_run_time; }
 
+  // Also print times with the profiler's own overhead subtracted.
+  bool print_compensated_times() const { return print_compensated_times_; }
+  void set_print_compensated_times(bool print_compensated_times) {
+    print_compensated_times_ = print_compensated_times;
+  }
+
+  // Also print the stack and heap usage (see Profiler::FEATURE_MEMORY).
+  bool print_memory_usage() const { return print_memory_usage_; }
+  void set_print_memory_usage(bool print_memory_usage) {
+    print_memory_usage_ = print_memory_usage;
+  }
+
+  // Also split total times into time on and off the CPU (see
+  // Profiler::FEATURE_CPU_TIME).
+  bool print_cpu_time() const { return print_cpu_time_; }
+  void set_print_cpu_time(bool print_cpu_time) {
+    print_cpu_time_ = print_cpu_time;
+  }
+
  private:
   std::ostream *stream_;
   std::string script_name_;
   bool print_date_;
   bool print_run_time_;
+  bool print_compensated_times_;
+  bool print_memory_usage_;
+  bool print_cpu_time_;
 };
 
 } // namespace amxprof
@@ -22,11 +22,15 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+#include <cstdio>
 #include <iomanip>
 #include <iostream>
 #include "duration.h"
 #include "function.h"
 #include "function_statistics.h"
+#include "native_argument_values.h"
+#include "native_arguments.h"
+#include "native_call_sites.h"
 #include "statistics_writer_html.h"
 #include "performance_counter.h"
 #include "statistics.h"
@@ -34,6 +38,39 @@
 
 namespace amxprof {
 
+namespace {
+
+// How many call sites are listed in the redundant native calls table.
+const std::size_t kMaxRedundantCallSites = 20;
+
+void WriteCallSiteLocation(std::ostream *stream, const NativeCallSite *site) {
+  if (site->file[0] != '\0') {
+    *stream << site->file << ":" << site->line;
+  } else {
+    char address[16];
+    std::sprintf(address, "0x%08lx", static_cast<unsigned long>(site->address));
+    *stream << address;
+  }
+}
+
+void WriteMemoryPeak(std::ostream *stream,
+                     const char *name,
+                     const MemoryPeak *peak) {
+  *stream << "  <p id=\"peak-" << name << "\">Peak " << name << " usage: "
+          << peak->usage << " bytes";
+  const char *separator = " in ";
+  if (peak->depth > static_cast<long>(peak->call_stack.size())) {
+    *stream << " in ...";
+    separator = " &gt; ";
+  }
+  for (std::size_t i = 0; i < peak->call_stack.size(); i++) {
+    *stream << (i == 0 ? separator : " &gt; ") << peak->call_stack[i]->name();
+  }
+  *stream << "</p>\n";
+}
+
+} // anonymous namespace
+
 void StatisticsWriterHtml::Write(const Statistics *stats)
 {
   *stream() << "\
@@ -188,7 +225,30 @@ void StatisticsWriterHtml::Write(const Statistics *stats)
         <th rowspan=\"2\" data-sort-index=\"1\">Name</th>\n\
         <th rowspan=\"2\" data-sort-index=\"2\">Calls</th>\n\
         <th colspan=\"4\" data-sort-index=\"3\" class=\"group\">Self Time</th>\n\
-        <th colspan=\"4\" data-sort-index=\"7\" class=\"group\">Total Time</th>\n\
+        <th colspan=\"4\" data-sort-index=\"7\" class=\"group\">Total Time</th>\n";
+
+  if (print_compensated_times()) {
+    *stream() << "\
+        <th colspan=\"2\" data-sort-index=\"11\" class=\"group\">Compensated</th>\n";
+  }
+
+  // The memory columns come after the compensated times, if any.
+  int memory_sort_index = print_compensated_times() ? 13 : 11;
+  if (print_memory_usage()) {
+    *stream()
+      << "        <th colspan=\"2\" data-sort-index=\"" << memory_sort_index
+      << "\" class=\"group\">Max. Memory (bytes)</th>\n";
+  }
+
+  int cpu_time_sort_index =
+    memory_sort_index + (print_memory_usage() ? 2 : 0);
+  if (print_cpu_time()) {
+    *stream()
+      << "        <th colspan=\"2\" data-sort-index=\"" << cpu_time_sort_index
+      << "\" class=\"group\">Total Time on CPU</th>\n";
+  }
+
+  *stream() << "\
       </tr>\n\
       <tr>\n\
         <th data-sort-index=\"3\">%</th>\n\
@@ -198,7 +258,31 @@ void StatisticsWriterHtml::Write(const Statistics *stats)
         <th data-sort-index=\"7\">%</th>\n\
         <th data-sort-index=\"8\">Overall</th>\n\
         <th data-sort-index=\"9\">Average</th>\n\
-        <th data-sort-index=\"10\">Worst</th>\n\
+        <th data-sort-index=\"10\">Worst</th>\n";
+
+  if (print_compensated_times()) {
+    *stream() << "\
+        <th data-sort-index=\"11\">Self</th>\n\
+        <th data-sort-index=\"12\">Total</th>\n";
+  }
+
+  if (print_memory_usage()) {
+    *stream()
+      << "        <th data-sort-index=\"" << memory_sort_index
+      << "\">Stack</th>\n"
+      << "        <th data-sort-index=\"" << memory_sort_index + 1
+      << "\">Heap</th>\n";
+  }
+
+  if (print_cpu_time()) {
+    *stream()
+      << "        <th data-sort-index=\"" << cpu_time_sort_index
+      << "\">On</th>\n"
+      << "        <th data-sort-index=\"" << cpu_time_sort_index + 1
+      << "\">Off</th>\n";
+  }
+
+  *stream() << "\
       </tr>\n\
     </thead>\n\
     <tbody>\n";
@@ -208,17 +292,8 @@ void StatisticsWriterHtml::Write(const Statistics *stats)
 
   typedef std::vector<FunctionStatistics*>::const_iterator FuncIterator;
 
-  Nanoseconds self_time_all;
-  for (FuncIterator it = all_fn_stats.begin(); it != all_fn_stats.end(); ++it) {
-    const FunctionStatistics *fn_stats = *it;
-    self_time_all += fn_stats->self_time();
-  };
-
-  Nanoseconds total_time_all;
-  for (FuncIterator it = all_fn_stats.begin(); it != all_fn_stats.end(); ++it) {
-    const FunctionStatistics *fn_stats = *it;
-    total_time_all += fn_stats->total_time();
-  };
+  Nanoseconds self_time_all = stats->GetTotalSelfTime();
+  Nanoseconds total_time_all = stats->GetTotalTotalTime();
 
   std::ostream::fmtflags flags = stream()->flags();
   stream()->flags(flags | std::ostream::fixed);
@@ -246,8 +321,23 @@ void StatisticsWriterHtml::Write(const Statistics *stats)
 
     *stream()
     << "    <tr>\n"
-    << "      <td>" << fn_stats->function()->GetTypeString() << "</td>\n"
-    << "      <td>" << fn_stats->function()->name() << "</td>\n"
+    << "      <td>" << fn_stats->function()->GetTypeString() << "</td>\n";
+
+    if (fn_stats->is_sampled()) {
+      *stream()
+      << "      <td title=\"Timed " << fn_stats->num_samples()
+                          << " of " << fn_stats->num_calls()
+                          << " calls, self time &plusmn;"
+                          << std::setprecision(1)
+                          << fn_stats->self_time_error() * 100
+                          << "% (95% confidence)\">"
+                          << fn_stats->function()->name() << " *</td>\n";
+    } else {
+      *stream()
+      << "      <td>" << fn_stats->function()->name() << "</td>\n";
+    }
+
+    *stream()
     << "      <td class=\"numeric\">" << fn_stats->num_calls() << "</td>\n"
     << "      <td class=\"numeric\">" << std::setprecision(2)
                                       << self_time_percent << "%</td>\n"
@@ -264,15 +354,299 @@ void StatisticsWriterHtml::Write(const Statistics *stats)
     << "      <td class=\"numeric\">" << std::setprecision(1)
                                       << avg_total_time << "</td>\n"
     << "      <td class=\"numeric\">" << std::setprecision(1)
-                                      << worst_total_time << "</td>\n"
-    << "    </tr>\n";
+                                      << worst_total_time << "</td>\n";
+
+    if (print_compensated_times()) {
+      double compensated_self_time =
+        Seconds(fn_stats->compensated_self_time()).count();
+      double compensated_total_time =
+        Seconds(fn_stats->compensated_total_time()).count();
+      *stream()
+      << "      <td class=\"numeric\">" << std::setprecision(1)
+                                        << compensated_self_time << "</td>\n"
+      << "      <td class=\"numeric\">" << std::setprecision(1)
+                                        << compensated_total_time << "</td>\n";
+    }
+
+    if (print_memory_usage()) {
+      *stream()
+      << "      <td class=\"numeric\">" << fn_stats->max_stack_usage()
+                                        << "</td>\n"
+      << "      <td class=\"numeric\">" << fn_stats->max_heap_usage()
+                                        << "</td>\n";
+    }
+
+    if (print_cpu_time()) {
+      double on_cpu_time = Seconds(fn_stats->on_cpu_time()).count();
+      double off_cpu_time = Seconds(fn_stats->off_cpu_time()).count();
+      *stream()
+      << "      <td class=\"numeric\">" << std::setprecision(1)
+                                        << on_cpu_time << "</td>\n"
+      << "      <td class=\"numeric\">" << std::setprecision(1)
+                                        << off_cpu_time << "</td>\n";
+    }
+
+    *stream() << "    </tr>\n";
   };
 
+  *stream() << "\
+    </tbody>\n\
+  </table>\n";
+
+  if (print_memory_usage()) {
+    WriteMemoryPeak(stream(), "stack", stats->peak_stack());
+    WriteMemoryPeak(stream(), "heap", stats->peak_heap());
+  }
+
+  const NativeCallSites *call_sites = stats->native_call_sites();
+  if (call_sites->size() > 0) {
+    *stream() << "\
+  <table id=\"native-call-sites\">\n\
+    <thead>\n\
+      <tr>\n\
+        <th>Native</th>\n\
+        <th>Caller</th>\n\
+        <th>Location</th>\n\
+        <th>Calls</th>\n\
+        <th>Time (s)</th>\n\
+        <th>Time (% of native)</th>\n\
+      </tr>\n\
+    </thead>\n\
+    <tbody>\n";
+
+    for (FuncIterator it = all_fn_stats.begin();
+         it != all_fn_stats.end(); ++it) {
+      const FunctionStatistics *fn_stats = *it;
+      if (fn_stats->function()->type() != Function::NATIVE) {
+        continue;
+      }
+      std::vector<const NativeCallSite*> sites;
+      call_sites->GetCallSites(fn_stats->function(), sites);
+      for (std::vector<const NativeCallSite*>::const_iterator site_it =
+             sites.begin(); site_it != sites.end(); ++site_it) {
+        const NativeCallSite *site = *site_it;
+        double percent = fn_stats->total_time().count() > 0
+          ? site->total_time.count() * 100 / fn_stats->total_time().count()
+          : 0;
+        *stream()
+        << "      <tr>\n"
+        << "        <td>" << fn_stats->function()->name() << "</td>\n"
+        << "        <td>" << site->caller->name() << "</td>\n"
+        << "        <td>";
+        WriteCallSiteLocation(stream(), site);
+        *stream()
+        << "</td>\n"
+        << "        <td class=\"numeric\">" << site->num_calls << "</td>\n"
+        << "        <td class=\"numeric\">" << std::setprecision(3)
+                                            << Seconds(site->total_time).count()
+                                            << "</td>\n"
+        << "        <td class=\"numeric\">" << std::setprecision(2)
+                                            << percent << "%</td>\n"
+        << "      </tr>\n";
+      }
+    }
+
+    *stream() << "\
+    </tbody>\n\
+  </table>\n";
+  }
+
+  std::vector<const NativeCallSite*> redundant_sites;
+  call_sites->GetRedundantCallSites(redundant_sites);
+  if (!redundant_sites.empty()) {
+    *stream() << "\
+  <table id=\"redundant-native-calls\">\n\
+    <thead>\n\
+      <tr>\n\
+        <th>Native</th>\n\
+        <th>Caller</th>\n\
+        <th>Location</th>\n\
+        <th>Calls</th>\n\
+        <th>Redundant calls</th>\n\
+        <th>Max. repeats</th>\n\
+        <th>Wasted time (ms)</th>\n\
+      </tr>\n\
+    </thead>\n\
+    <tbody>\n";
+
+    for (std::size_t i = 0;
+         i < redundant_sites.size() && i < kMaxRedundantCallSites; i++) {
+      const NativeCallSite *site = redundant_sites[i];
+      *stream()
+      << "      <tr>\n"
+      << "        <td>" << site->native->name() << "</td>\n"
+      << "        <td>" << site->caller->name() << "</td>\n"
+      << "        <td>";
+      WriteCallSiteLocation(stream(), site);
+      *stream()
+      << "</td>\n"
+      << "        <td class=\"numeric\">" << site->num_calls << "</td>\n"
+      << "        <td class=\"numeric\">" << site->num_redundant_calls
+                                          << "</td>\n"
+      << "        <td class=\"numeric\">" << site->max_repeats << "</td>\n"
+      << "        <td class=\"numeric\">" << std::setprecision(3)
+                                          << Milliseconds(
+                                               site->redundant_time).count()
+                                          << "</td>\n"
+      << "      </tr>\n";
+    }
+
+    *stream() << "\
+    </tbody>\n\
+  </table>\n";
+  }
+
+  const NativeArgumentValues *arg_values = stats->native_argument_values();
+  bool have_arg_values = false;
+  for (FuncIterator it = all_fn_stats.begin(); it != all_fn_stats.end(); ++it) {
+    const FunctionStatistics *fn_stats = *it;
+    if (fn_stats->function()->type() != Function::NATIVE) {
+      continue;
+    }
+    for (const NativeArgumentValues::TrackedArgument *tracked =
+           arg_values->Find(fn_stats->function()->index());
+         tracked != 0; tracked = tracked->next) {
+      if (tracked->values.num_calls() == 0) {
+        continue;
+      }
+      if (!have_arg_values) {
+        *stream() << "\
+  <table id=\"native-argument-values\">\n\
+    <thead>\n\
+      <tr>\n\
+        <th>Native</th>\n\
+        <th>Argument</th>\n\
+        <th>Value</th>\n\
+        <th>Calls</th>\n\
+        <th>Time (s)</th>\n\
+        <th>Time (% of argument)</th>\n\
+        <th>Max. error (s)</th>\n\
+      </tr>\n\
+    </thead>\n\
+    <tbody>\n";
+        have_arg_values = true;
+      }
+      Nanoseconds total_time = tracked->values.total_time();
+      std::vector<const ArgumentValueCounter*> values;
+      tracked->values.GetTopValues(values);
+      for (std::vector<const ArgumentValueCounter*>::const_iterator value_it =
+             values.begin(); value_it != values.end(); ++value_it) {
+        const ArgumentValueCounter *value = *value_it;
+        double percent = total_time.count() > 0
+          ? value->time.count() * 100 / total_time.count()
+          : 0;
+        *stream()
+        << "      <tr>\n"
+        << "        <td>" << fn_stats->function()->name() << "</td>\n"
+        << "        <td class=\"numeric\">" << tracked->position << "</td>\n"
+        << "        <td class=\"numeric\">" << value->value << "</td>\n"
+        << "        <td class=\"numeric\">" << value->num_calls << "</td>\n"
+        << "        <td class=\"numeric\">" << std::setprecision(3)
+                                            << Seconds(value->time).count()
+                                            << "</td>\n"
+        << "        <td class=\"numeric\">" << std::setprecision(2)
+                                            << percent << "%</td>\n"
+        << "        <td class=\"numeric\">" << std::setprecision(3)
+                                            << Seconds(value->error).count()
+                                            << "</td>\n"
+        << "      </tr>\n";
+      }
+    }
+  }
+  if (have_arg_values) {
+    *stream() << "\
+    </tbody>\n\
+  </table>\n";
+  }
+
+  bool have_args = false;
+  bool have_payload = false;
+  for (FuncIterator it = all_fn_stats.begin(); it != all_fn_stats.end(); ++it) {
+    const NativeArgumentStatistics *args = (*it)->argument_statistics();
+    if (args != 0 && args->num_calls() > 0) {
+      have_args = true;
+      if (args->num_measured_calls() > 0) {
+        have_payload = true;
+        break;
+      }
+    }
+  }
+  if (have_args) {
+    *stream() << "\
+  <table id=\"native-arguments\">\n\
+    <thead>\n\
+      <tr>\n\
+        <th>Native</th>\n\
+        <th>Calls</th>\n\
+        <th>Avg. arguments</th>\n\
+        <th>Avg. string length</th>\n\
+        <th>Time per character (ns)</th>\n\
+        <th>Longest strings</th>\n\
+        <th>Avg. time with longest strings (us)</th>\n\
+      </tr>\n\
+    </thead>\n\
+    <tbody>\n";
+
+    for (FuncIterator it = all_fn_stats.begin();
+         it != all_fn_stats.end(); ++it) {
+      const FunctionStatistics *fn_stats = *it;
+      const NativeArgumentStatistics *args = fn_stats->argument_statistics();
+      if (args == 0 || args->num_calls() == 0) {
+        continue;
+      }
+      *stream()
+      << "      <tr>\n"
+      << "        <td>" << fn_stats->function()->name() << "</td>\n"
+      << "        <td class=\"numeric\">" << args->num_calls() << "</td>\n"
+      << "        <td class=\"numeric\">" << std::setprecision(1)
+                                          << args->GetAverageNumArgs()
+                                          << "</td>\n";
+      if (args->num_measured_calls() == 0) {
+        *stream()
+        << "        <td></td>\n"
+        << "        <td></td>\n"
+        << "        <td></td>\n"
+        << "        <td></td>\n"
+        << "      </tr>\n";
+        continue;
+      }
+      int longest = NativeArgumentStatistics::kNumPayloadBuckets - 1;
+      while (longest > 0 && args->payload_bucket(longest).num_calls == 0) {
+        longest--;
+      }
+      const NativeArgumentBucket &bucket = args->payload_bucket(longest);
+      *stream()
+      << "        <td class=\"numeric\">" << std::setprecision(1)
+                                          << static_cast<double>(
+                                               args->total_payload_size())
+                                             / args->num_measured_calls()
+                                          << "</td>\n"
+      << "        <td class=\"numeric\">" << std::setprecision(2)
+                                          << args->GetTimePerByte()
+                                          << "</td>\n"
+      << "        <td class=\"numeric\">"
+        << NativeArgumentStatistics::GetPayloadBucketMin(longest) << "+</td>\n"
+      << "        <td class=\"numeric\">" << std::setprecision(2)
+                                          << Microseconds(bucket.time).count()
+                                             / bucket.num_calls
+                                          << "</td>\n"
+      << "      </tr>\n";
+    }
+
+    *stream() << "\
+    </tbody>\n\
+  </table>\n";
+    if (have_payload) {
+      *stream() << "\
+  <p id=\"native-arguments-note\">String lengths are estimated: natives have\n\
+  no signatures, so any argument that points to a zero-terminated run of text\n\
+  is counted as a string.</p>\n";
+    }
+  }
+
   stream()->flags(flags);
 
   *stream() << "\
-    </tbody>\n\
-  </table>\n\
 </body>\n\
 </html>\n";
 }
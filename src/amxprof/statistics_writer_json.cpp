@@ -26,6 +26,9 @@
 #include "duration.h"
 #include "function.h"
 #include "function_statistics.h"
+#include "native_argument_values.h"
+#include "native_arguments.h"
+#include "native_call_sites.h"
 #include "performance_counter.h"
 #include "statistics_writer_json.h"
 #include "statistics.h"
@@ -33,32 +36,79 @@
 
 namespace amxprof {
 
-static std::string EscapString(const std::string &s) {
-  std::string t;
+namespace {
 
-  for (std::string::const_iterator iterator = s.begin();
-       iterator != s.end(); ++iterator) {
-    switch (*iterator) {
+// Writes the string escaped directly to the stream, without building
+// a copy of it.
+struct EscapedString {
+  explicit EscapedString(const char *s) : s(s) {}
+  const char *s;
+};
+
+std::ostream &operator<<(std::ostream &stream, const EscapedString &e) {
+  for (const char *p = e.s; *p != '\0'; p++) {
+    switch (*p) {
       // According to http://www.json.org other escape sequences,
       // apart from Unicode, are not supported by JSON.
-      case '"': t.append("\\\""); break;
-      case '\\': t.append("\\\\"); break;
-      case '\b': t.append("\\b"); break;
-      case '\f': t.append("\\f"); break;
-      case '\n': t.append("\\n"); break;
-      case '\r': t.append("\\r"); break;
-      case '\t': t.append("\\t"); break;
-      default: t.push_back(*iterator);
+      case '"': stream << "\\\""; break;
+      case '\\': stream << "\\\\"; break;
+      case '\b': stream << "\\b"; break;
+      case '\f': stream << "\\f"; break;
+      case '\n': stream << "\\n"; break;
+      case '\r': stream << "\\r"; break;
+      case '\t': stream << "\\t"; break;
+      default: stream.put(*p);
     }
   }
+  return stream;
+}
 
-  return t;
+EscapedString EscapString(const char *s) {
+  return EscapedString(s);
+}
+
+void WriteMemoryPeak(std::ostream *stream,
+                     const char *key,
+                     const MemoryPeak *peak) {
+  *stream << "  \"" << key << "\": {\n"
+          << "    \"usage\": " << peak->usage << ",\n"
+          << "    \"depth\": " << peak->depth << ",\n"
+          << "    \"callStack\": [";
+  for (std::size_t i = 0; i < peak->call_stack.size(); i++) {
+    *stream << (i == 0 ? "\"" : ", \"")
+            << EscapString(peak->call_stack[i]->name()) << "\"";
+  }
+  *stream << "]\n  },\n";
+}
+
+// Writes the non-empty buckets as [lower bound, calls, total time].
+void WriteArgumentBuckets(std::ostream *stream,
+                          const NativeArgumentStatistics *args,
+                          bool payload) {
+  int num_buckets = payload ? NativeArgumentStatistics::kNumPayloadBuckets
+                            : NativeArgumentStatistics::kNumArgCountBuckets;
+  bool first = true;
+  *stream << "[";
+  for (int i = 0; i < num_buckets; i++) {
+    const NativeArgumentBucket &bucket =
+      payload ? args->payload_bucket(i) : args->arg_count_bucket(i);
+    if (bucket.num_calls == 0) {
+      continue;
+    }
+    *stream << (first ? "" : ", ") << "["
+            << (payload ? NativeArgumentStatistics::GetPayloadBucketMin(i) : i)
+            << ", " << bucket.num_calls << ", " << bucket.time.count() << "]";
+    first = false;
+  }
+  *stream << "]";
 }
 
+} // anonymous namespace
+
 void StatisticsWriterJson::Write(const Statistics *stats)
 {
   *stream() << "{\n"
-            << "  \"script\": \"" << EscapString(script_name()) << "\",\n";
+            << "  \"script\": \"" << EscapString(script_name().c_str()) << "\",\n";
 
   if (print_date()) {
     *stream() << "  \"timestamp\": " << TimeStamp::Now() << ",\n";
@@ -69,6 +119,17 @@ void StatisticsWriterJson::Write(const Statistics *stats)
               << Seconds(stats->GetTotalRunTime()).count() << ",\n";
   }
 
+  const NativeCallSites *call_sites = stats->native_call_sites();
+  if (call_sites->num_dropped_calls() > 0) {
+    *stream() << "  \"droppedCallSiteCalls\": "
+              << call_sites->num_dropped_calls() << ",\n";
+  }
+
+  if (print_memory_usage()) {
+    WriteMemoryPeak(stream(), "peakStack", stats->peak_stack());
+    WriteMemoryPeak(stream(), "peakHeap", stats->peak_heap());
+  }
+
   *stream() << "  \"functions\": [\n";
 
   std::vector<FunctionStatistics*> all_fn_stats;
@@ -83,9 +144,31 @@ void StatisticsWriterJson::Write(const Statistics *stats)
       << "      \"type\": \""
         << fn_stats->function()->GetTypeString() << "\",\n"
       << "      \"name\": \""
-        << fn_stats->function()->name() << "\",\n"
+        << EscapString(fn_stats->function()->name()) << "\",\n";
+
+    if (fn_stats->function()->file()[0] != '\0') {
+      *stream()
+        << "      \"file\": \""
+          << EscapString(fn_stats->function()->file()) << "\",\n"
+        << "      \"line\": "
+          << fn_stats->function()->line() << ",\n";
+    }
+
+    *stream()
       << "      \"calls\": "
-       << fn_stats->num_calls() << ",\n"
+       << fn_stats->num_calls() << ",\n";
+
+    if (fn_stats->is_sampled()) {
+      *stream()
+        << "      \"sampleInterval\": "
+          << fn_stats->sample_interval() << ",\n"
+        << "      \"samples\": "
+          << fn_stats->num_samples() << ",\n"
+        << "      \"selfTimeError\": "
+          << fn_stats->self_time_error() << ",\n";
+    }
+
+    *stream()
       << "      \"selfTime\": "
         << fn_stats->self_time().count() << ",\n"
       << "      \"worstSelfTime\": "
@@ -93,8 +176,123 @@ void StatisticsWriterJson::Write(const Statistics *stats)
       << "      \"totalTime\": "
         << fn_stats->total_time().count() << ",\n"
       << "      \"worstTotalTime\": "
-        << fn_stats->worst_total_time().count() << "\n"
-    << "    },\n";
+        << fn_stats->worst_total_time().count();
+
+    if (print_compensated_times()) {
+      *stream()
+        << ",\n"
+        << "      \"compensatedSelfTime\": "
+          << fn_stats->compensated_self_time().count() << ",\n"
+        << "      \"compensatedTotalTime\": "
+          << fn_stats->compensated_total_time().count();
+    }
+
+    if (print_memory_usage()) {
+      *stream()
+        << ",\n"
+        << "      \"maxStackUsage\": " << fn_stats->max_stack_usage() << ",\n"
+        << "      \"maxHeapUsage\": " << fn_stats->max_heap_usage();
+    }
+
+    if (print_cpu_time()) {
+      *stream()
+        << ",\n"
+        << "      \"onCpuTime\": " << fn_stats->on_cpu_time().count() << ",\n"
+        << "      \"offCpuTime\": " << fn_stats->off_cpu_time().count();
+    }
+
+    if (fn_stats->function()->type() == Function::NATIVE) {
+      std::vector<const NativeCallSite*> sites;
+      call_sites->GetCallSites(fn_stats->function(), sites);
+      if (!sites.empty()) {
+        *stream() << ",\n      \"callSites\": [\n";
+        for (std::size_t i = 0; i < sites.size(); i++) {
+          const NativeCallSite *site = sites[i];
+          *stream()
+            << "        {\n"
+            << "          \"address\": " << site->address << ",\n"
+            << "          \"caller\": \""
+              << EscapString(site->caller->name()) << "\",\n";
+          if (site->file[0] != '\0') {
+            *stream()
+              << "          \"file\": \"" << EscapString(site->file) << "\",\n"
+              << "          \"line\": " << site->line << ",\n";
+          }
+          if (site->num_redundant_calls > 0) {
+            *stream()
+              << "          \"redundantCalls\": "
+                << site->num_redundant_calls << ",\n"
+              << "          \"redundantTime\": "
+                << site->redundant_time.count() << ",\n"
+              << "          \"maxRepeats\": " << site->max_repeats << ",\n";
+          }
+          *stream()
+            << "          \"calls\": " << site->num_calls << ",\n"
+            << "          \"totalTime\": " << site->total_time.count() << "\n"
+            << "        }" << (i + 1 < sites.size() ? ",\n" : "\n");
+        }
+        *stream() << "      ]";
+      }
+    }
+
+    const NativeArgumentValues::TrackedArgument *tracked =
+      fn_stats->function()->type() == Function::NATIVE
+        ? stats->native_argument_values()->Find(fn_stats->function()->index())
+        : 0;
+    bool have_arg_values = false;
+    for (; tracked != 0; tracked = tracked->next) {
+      if (tracked->values.num_calls() == 0) {
+        continue;
+      }
+      std::vector<const ArgumentValueCounter*> values;
+      tracked->values.GetTopValues(values);
+      *stream()
+        << (have_arg_values ? ",\n" : ",\n      \"argumentValues\": [\n")
+        << "        {\n"
+        << "          \"argument\": " << tracked->position << ",\n"
+        << "          \"calls\": " << tracked->values.num_calls() << ",\n"
+        << "          \"totalTime\": "
+          << tracked->values.total_time().count() << ",\n"
+        << "          \"values\": [\n";
+      for (std::size_t i = 0; i < values.size(); i++) {
+        *stream()
+          << "            {"
+          << "\"value\": " << values[i]->value << ", "
+          << "\"calls\": " << values[i]->num_calls << ", "
+          << "\"time\": " << values[i]->time.count() << ", "
+          << "\"error\": " << values[i]->error.count() << "}"
+          << (i + 1 < values.size() ? ",\n" : "\n");
+      }
+      *stream() << "          ]\n        }";
+      have_arg_values = true;
+    }
+    if (have_arg_values) {
+      *stream() << "\n      ]";
+    }
+
+    const NativeArgumentStatistics *args = fn_stats->argument_statistics();
+    if (args != 0 && args->num_calls() > 0) {
+      *stream() << ",\n      \"arguments\": {\n"
+                << "        \"counts\": ";
+      WriteArgumentBuckets(stream(), args, false);
+      if (args->num_measured_calls() > 0) {
+        *stream()
+          << ",\n"
+          // String arguments are guessed, see GetStringArgumentsLength().
+          << "        \"payloadEstimated\": true,\n"
+          << "        \"payloadCalls\": "
+            << args->num_measured_calls() << ",\n"
+          << "        \"payloadSize\": "
+            << args->total_payload_size() << ",\n"
+          << "        \"timePerByte\": "
+            << args->GetTimePerByte() << ",\n"
+          << "        \"payloads\": ";
+        WriteArgumentBuckets(stream(), args, true);
+      }
+      *stream() << "\n      }";
+    }
+
+    *stream() << "\n    },\n";
   }
 
   *stream() << "    {}\n  ]\n}\n";
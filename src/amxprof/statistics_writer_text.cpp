@@ -22,11 +22,15 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+#include <cstdio>
 #include <iomanip>
 #include <iostream>
 #include "duration.h"
 #include "function.h"
 #include "function_statistics.h"
+#include "native_argument_values.h"
+#include "native_arguments.h"
+#include "native_call_sites.h"
 #include "performance_counter.h"
 #include "statistics_writer_text.h"
 #include "statistics.h"
@@ -43,6 +47,9 @@ static const int kTotalTimePercentWidth = 15;
 static const int kTotalTimeWidth = 15;
 static const int kAvgTotalTimeWidth = 15;
 static const int kWorstTotalTimeWidth = 15;
+static const int kCompensatedTimeWidth = 15;
+static const int kMemoryUsageWidth = 15;
+static const int kCpuTimeWidth = 15;
 
 static const int kWidthAll = kTypeWidth + kNameWidth + kCallsWidth
   + kSelfTimePercentWidth + kSelfTimeWidth + kAvgSelfTimeWidth + kWorstSelfTimeWidth
@@ -50,11 +57,60 @@ static const int kWidthAll = kTypeWidth + kNameWidth + kCallsWidth
 
 static const int kNumColumns = 11;
 
+// How many call sites are listed under "Redundant native calls".
+static const std::size_t kMaxRedundantCallSites = 20;
+
 namespace amxprof {
 
+namespace {
+
+void WriteCallSiteLocation(std::ostream *stream, const NativeCallSite *site) {
+  if (site->file[0] != '\0') {
+    *stream << site->file << ":" << site->line;
+  } else {
+    char address[16];
+    std::sprintf(address, "0x%08lx", static_cast<unsigned long>(site->address));
+    *stream << address;
+  }
+}
+
+void WriteMemoryPeak(std::ostream *stream,
+                     const char *name,
+                     const MemoryPeak *peak) {
+  *stream << "Peak " << name << " usage: " << peak->usage << " bytes";
+  const char *separator = " in ";
+  if (peak->depth > static_cast<long>(peak->call_stack.size())) {
+    *stream << " in ...";
+    separator = " > ";
+  }
+  for (std::size_t i = 0; i < peak->call_stack.size(); i++) {
+    *stream << (i == 0 ? separator : " > ") << peak->call_stack[i]->name();
+  }
+  *stream << "\n";
+}
+
+void WriteArgumentBucket(std::ostream *stream,
+                         const NativeArgumentBucket &bucket) {
+  *stream << bucket.num_calls << " calls, " << std::setprecision(2)
+          << Microseconds(bucket.time).count() / bucket.num_calls
+          << " us per call\n";
+}
+
+} // anonymous namespace
+
 void StatisticsWriterText::DoHLine() {
+  int width = kWidthAll + kNumColumns * 2 + 1;
+  if (print_compensated_times()) {
+    width += (kCompensatedTimeWidth + 2) * 2;
+  }
+  if (print_memory_usage()) {
+    width += (kMemoryUsageWidth + 2) * 2;
+  }
+  if (print_cpu_time()) {
+    width += (kCpuTimeWidth + 2) * 2;
+  }
   char fillch = stream()->fill();
-  *stream() << std::setw(kWidthAll + kNumColumns * 2 + 1)
+  *stream() << std::setw(width)
             << std::setfill('-') << "" << std::setfill(fillch) << '\n';
 }
 
@@ -82,8 +138,23 @@ void StatisticsWriterText::Write(const Statistics *stats)
     << "| " << std::setw(kTotalTimePercentWidth) << "Total Time (%)"
     << "| " << std::setw(kTotalTimeWidth) << "Total Time (s)"
     << "| " << std::setw(kAvgTotalTimeWidth) << "Avg. TT (ms)"
-    << "| " << std::setw(kWorstTotalTimeWidth) << "Worst TT (ms)"
-    << "|\n";
+    << "| " << std::setw(kWorstTotalTimeWidth) << "Worst TT (ms)";
+  if (print_compensated_times()) {
+    *stream()
+      << "| " << std::setw(kCompensatedTimeWidth) << "Comp. ST (s)"
+      << "| " << std::setw(kCompensatedTimeWidth) << "Comp. TT (s)";
+  }
+  if (print_memory_usage()) {
+    *stream()
+      << "| " << std::setw(kMemoryUsageWidth) << "Max. stack (B)"
+      << "| " << std::setw(kMemoryUsageWidth) << "Max. heap (B)";
+  }
+  if (print_cpu_time()) {
+    *stream()
+      << "| " << std::setw(kCpuTimeWidth) << "On-CPU TT (s)"
+      << "| " << std::setw(kCpuTimeWidth) << "Off-CPU TT (s)";
+  }
+  *stream() << "|\n";
   DoHLine();
 
   std::vector<FunctionStatistics*> all_fn_stats;
@@ -91,17 +162,8 @@ void StatisticsWriterText::Write(const Statistics *stats)
 
   typedef std::vector<FunctionStatistics*>::const_iterator FuncIterator;
 
-  Nanoseconds self_time_all;
-  for (FuncIterator it = all_fn_stats.begin(); it != all_fn_stats.end(); ++it) {
-    const FunctionStatistics *fn_stats = *it;
-    self_time_all += fn_stats->self_time();
-  }
-
-  Nanoseconds total_time_all;
-  for (FuncIterator it = all_fn_stats.begin(); it != all_fn_stats.end(); ++it) {
-    const FunctionStatistics *fn_stats = *it;
-    total_time_all += fn_stats->total_time();
-  }
+  Nanoseconds self_time_all = stats->GetTotalSelfTime();
+  Nanoseconds total_time_all = stats->GetTotalTotalTime();
 
   std::ostream::fmtflags flags = stream()->flags();
   stream()->flags(flags | std::ostream::fixed);
@@ -146,11 +208,218 @@ void StatisticsWriterText::Write(const Statistics *stats)
       << "| " << std::setw(kAvgTotalTimeWidth) << std::setprecision(1)
         << avg_total_time
       << "| " << std::setw(kWorstTotalTimeWidth) << std::setprecision(1)
-        << worst_total_time
-      << "|\n";
+        << worst_total_time;
+    if (print_compensated_times()) {
+      *stream()
+        << "| " << std::setw(kCompensatedTimeWidth) << std::setprecision(1)
+          << Seconds(fn_stats->compensated_self_time()).count()
+        << "| " << std::setw(kCompensatedTimeWidth) << std::setprecision(1)
+          << Seconds(fn_stats->compensated_total_time()).count();
+    }
+    if (print_memory_usage()) {
+      *stream()
+        << "| " << std::setw(kMemoryUsageWidth) << fn_stats->max_stack_usage()
+        << "| " << std::setw(kMemoryUsageWidth) << fn_stats->max_heap_usage();
+    }
+    if (print_cpu_time()) {
+      *stream()
+        << "| " << std::setw(kCpuTimeWidth) << std::setprecision(1)
+          << Seconds(fn_stats->on_cpu_time()).count()
+        << "| " << std::setw(kCpuTimeWidth) << std::setprecision(1)
+          << Seconds(fn_stats->off_cpu_time()).count();
+    }
+    *stream() << "|\n";
     DoHLine();
   }
 
+  if (print_memory_usage()) {
+    WriteMemoryPeak(stream(), "stack", stats->peak_stack());
+    WriteMemoryPeak(stream(), "heap", stats->peak_heap());
+  }
+
+  bool have_sampled = false;
+  for (FuncIterator it = all_fn_stats.begin(); it != all_fn_stats.end(); ++it) {
+    const FunctionStatistics *fn_stats = *it;
+    if (!fn_stats->is_sampled()) {
+      continue;
+    }
+    if (!have_sampled) {
+      *stream() << "Sampled functions (times are extrapolated):\n";
+      have_sampled = true;
+    }
+    *stream() << "  " << fn_stats->function()->name()
+              << ": timed " << fn_stats->num_samples()
+              << " of " << fn_stats->num_calls() << " calls, self time +/- "
+              << std::setprecision(1) << fn_stats->self_time_error() * 100
+              << "% (95% confidence)\n";
+  }
+
+  const NativeCallSites *call_sites = stats->native_call_sites();
+  if (call_sites->size() > 0) {
+    *stream() << "Native call sites:\n";
+  }
+  for (FuncIterator it = all_fn_stats.begin(); it != all_fn_stats.end(); ++it) {
+    const FunctionStatistics *fn_stats = *it;
+    if (fn_stats->function()->type() != Function::NATIVE) {
+      continue;
+    }
+    std::vector<const NativeCallSite*> sites;
+    call_sites->GetCallSites(fn_stats->function(), sites);
+    if (sites.empty()) {
+      continue;
+    }
+    *stream() << "  " << fn_stats->function()->name()
+              << " (" << fn_stats->num_calls() << " calls, "
+              << std::setprecision(3)
+              << Seconds(fn_stats->total_time()).count() << " s):\n";
+    for (std::vector<const NativeCallSite*>::const_iterator site_it =
+           sites.begin(); site_it != sites.end(); ++site_it) {
+      const NativeCallSite *site = *site_it;
+      double percent = fn_stats->total_time().count() > 0
+        ? site->total_time.count() * 100 / fn_stats->total_time().count()
+        : 0;
+      *stream() << "    " << site->num_calls << " calls, "
+                << std::setprecision(3)
+                << Seconds(site->total_time).count() << " s ("
+                << std::setprecision(2) << percent << "%) from "
+                << site->caller->name() << " at ";
+      WriteCallSiteLocation(stream(), site);
+      *stream() << "\n";
+    }
+  }
+  if (call_sites->num_dropped_calls() > 0) {
+    *stream() << "  (" << call_sites->num_dropped_calls()
+              << " calls from other call sites are not shown)\n";
+  }
+
+  std::vector<const NativeCallSite*> redundant_sites;
+  call_sites->GetRedundantCallSites(redundant_sites);
+  if (!redundant_sites.empty()) {
+    *stream() << "Redundant native calls (same arguments earlier in the "
+                 "same callback):\n";
+  }
+  for (std::size_t i = 0;
+       i < redundant_sites.size() && i < kMaxRedundantCallSites; i++) {
+    const NativeCallSite *site = redundant_sites[i];
+    *stream() << "  " << site->native->name() << " from "
+              << site->caller->name() << " at ";
+    WriteCallSiteLocation(stream(), site);
+    *stream() << ": " << site->num_redundant_calls << " of "
+              << site->num_calls << " calls, up to " << site->max_repeats
+              << " repeats, " << std::setprecision(3)
+              << Milliseconds(site->redundant_time).count()
+              << " ms wasted\n";
+  }
+  if (redundant_sites.size() > kMaxRedundantCallSites) {
+    *stream() << "  (" << redundant_sites.size() - kMaxRedundantCallSites
+              << " more call sites are not shown)\n";
+  }
+
+  bool have_args = false;
+  bool have_payload = false;
+  for (FuncIterator it = all_fn_stats.begin(); it != all_fn_stats.end(); ++it) {
+    const FunctionStatistics *fn_stats = *it;
+    const NativeArgumentStatistics *args = fn_stats->argument_statistics();
+    if (args == 0 || args->num_calls() == 0) {
+      continue;
+    }
+    if (!have_args) {
+      *stream() << "Native arguments:\n";
+      have_args = true;
+    }
+    *stream() << "  " << fn_stats->function()->name()
+              << " (" << args->num_calls() << " calls";
+    if (args->GetAverageNumArgs() >= 0) {
+      *stream() << ", " << std::setprecision(1) << args->GetAverageNumArgs()
+                << " arguments on average";
+    }
+    if (args->num_measured_calls() > 0) {
+      have_payload = true;
+      *stream() << ", " << std::setprecision(1)
+                << static_cast<double>(args->total_payload_size())
+                   / args->num_measured_calls()
+                << " characters of strings on average, "
+                << std::setprecision(2) << args->GetTimePerByte()
+                << " ns per character";
+    }
+    *stream() << "):\n";
+    for (int i = 0; i < NativeArgumentStatistics::kNumArgCountBuckets; i++) {
+      const NativeArgumentBucket &bucket = args->arg_count_bucket(i);
+      if (bucket.num_calls > 0) {
+        *stream() << "    " << i;
+        if (i == NativeArgumentStatistics::kNumArgCountBuckets - 1) {
+          *stream() << "+";
+        }
+        *stream() << " arguments: ";
+        WriteArgumentBucket(stream(), bucket);
+      }
+    }
+    for (int i = 0; i < NativeArgumentStatistics::kNumPayloadBuckets; i++) {
+      const NativeArgumentBucket &bucket = args->payload_bucket(i);
+      if (bucket.num_calls > 0) {
+        *stream() << "    " << NativeArgumentStatistics::GetPayloadBucketMin(i);
+        if (i == NativeArgumentStatistics::kNumPayloadBuckets - 1) {
+          *stream() << "+";
+        } else if (i > 1) {
+          *stream() << "-"
+                    << NativeArgumentStatistics::GetPayloadBucketMin(i + 1) - 1;
+        }
+        *stream() << " characters: ";
+        WriteArgumentBucket(stream(), bucket);
+      }
+    }
+  }
+  if (have_payload) {
+    *stream() << "  (String lengths are estimated: natives have no signatures, "
+                 "so any argument\n"
+                 "  that points to a zero-terminated run of text is counted as "
+                 "a string.)\n";
+  }
+
+  const NativeArgumentValues *arg_values = stats->native_argument_values();
+  bool have_arg_values = false;
+  for (FuncIterator it = all_fn_stats.begin(); it != all_fn_stats.end(); ++it) {
+    const FunctionStatistics *fn_stats = *it;
+    if (fn_stats->function()->type() != Function::NATIVE) {
+      continue;
+    }
+    for (const NativeArgumentValues::TrackedArgument *tracked =
+           arg_values->Find(fn_stats->function()->index());
+         tracked != 0; tracked = tracked->next) {
+      if (tracked->values.num_calls() == 0) {
+        continue;
+      }
+      if (!have_arg_values) {
+        *stream() << "Native argument values (most time first):\n";
+        have_arg_values = true;
+      }
+      Nanoseconds total_time = tracked->values.total_time();
+      *stream() << "  " << fn_stats->function()->name() << " argument "
+                << tracked->position << " (" << tracked->values.num_calls()
+                << " calls, " << std::setprecision(3)
+                << Seconds(total_time).count() << " s):\n";
+      std::vector<const ArgumentValueCounter*> values;
+      tracked->values.GetTopValues(values);
+      for (std::vector<const ArgumentValueCounter*>::const_iterator value_it =
+             values.begin(); value_it != values.end(); ++value_it) {
+        const ArgumentValueCounter *value = *value_it;
+        double percent = total_time.count() > 0
+          ? value->time.count() * 100 / total_time.count()
+          : 0;
+        *stream() << "    " << value->value << ": " << value->num_calls
+                  << " calls, " << std::setprecision(3)
+                  << Seconds(value->time).count() << " s ("
+                  << std::setprecision(2) << percent << "%)";
+        if (value->error.count() > 0) {
+          *stream() << ", up to " << std::setprecision(3)
+                    << Seconds(value->error).count() << " s of it from other "
+                       "values";
+        }
+        *stream() << "\n";
+      }
+    }
+  }
+
   stream()->flags(flags);
 }
 
@@ -0,0 +1,128 @@
+// Copyright (c) 2015 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "string_pool.h"
+
+namespace amxprof {
+
+namespace {
+
+const std::size_t kBlockSize = 16384;
+const std::size_t kInitialCapacity = 256;
+
+uint32_t HashString(const char *s, std::size_t length) {
+  uint32_t h = 2166136261u;
+  for (std::size_t i = 0; i < length; i++) {
+    h ^= static_cast<unsigned char>(s[i]);
+    h *= 16777619u;
+  }
+  return h;
+}
+
+} // anonymous namespace
+
+StringPool::StringPool()
+ : block_ptr_(0),
+   block_space_(0),
+   num_strings_(0)
+{
+}
+
+StringPool::~StringPool() {
+  for (std::vector<char*>::const_iterator iterator = blocks_.begin();
+       iterator != blocks_.end(); ++iterator) {
+    delete[] *iterator;
+  }
+}
+
+const char *StringPool::Intern(const char *s, std::size_t length) {
+  // Keep the load factor at or below 1/2.
+  if ((num_strings_ + 1) * 2 > table_.size()) {
+    Rehash(table_.empty() ? kInitialCapacity : table_.size() * 2);
+  }
+
+  uint32_t hash = HashString(s, length);
+  std::size_t mask = table_.size() - 1;
+  std::size_t i = hash & mask;
+
+  for (; table_[i].data != 0; i = (i + 1) & mask) {
+    const Entry &entry = table_[i];
+    if (entry.hash == hash
+        && entry.length == length
+        && std::memcmp(entry.data, s, length) == 0) {
+      return entry.data;
+    }
+  }
+
+  char *data = Allocate(length + 1);
+  std::memcpy(data, s, length);
+  data[length] = '\0';
+
+  table_[i].data = data;
+  table_[i].length = length;
+  table_[i].hash = hash;
+  num_strings_++;
+
+  return data;
+}
+
+char *StringPool::Allocate(std::size_t size) {
+  // Big strings get a block of their own so that they don't waste the
+  // rest of the current block.
+  if (size > kBlockSize / 4) {
+    char *data = new char[size];
+    blocks_.push_back(data);
+    return data;
+  }
+  if (size > block_space_) {
+    block_ptr_ = new char[kBlockSize];
+    block_space_ = kBlockSize;
+    blocks_.push_back(block_ptr_);
+  }
+  char *data = block_ptr_;
+  block_ptr_ += size;
+  block_space_ -= size;
+  return data;
+}
+
+void StringPool::Rehash(std::size_t capacity) {
+  Entry empty = {0, 0, 0};
+  std::vector<Entry> table(capacity, empty);
+  std::size_t mask = capacity - 1;
+
+  for (std::vector<Entry>::const_iterator iterator = table_.begin();
+       iterator != table_.end(); ++iterator) {
+    if (iterator->data != 0) {
+      std::size_t i = iterator->hash & mask;
+      while (table[i].data != 0) {
+        i = (i + 1) & mask;
+      }
+      table[i] = *iterator;
+    }
+  }
+
+  table_.swap(table);
+}
+
+} // namespace amxprof
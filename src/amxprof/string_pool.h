@@ -0,0 +1,81 @@
+// Copyright (c) 2015 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef AMXPROF_STRING_POOL_H
+#define AMXPROF_STRING_POOL_H
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "macros.h"
+#include "stdint.h"
+
+namespace amxprof {
+
+// Keeps a single copy of each distinct string. Strings are packed into
+// large blocks and are only freed together with the pool, so the returned
+// pointers can be stored and compared without copying.
+class StringPool {
+ public:
+  StringPool();
+  ~StringPool();
+
+  // Returns the pooled, zero-terminated copy of the string. Equal strings
+  // always get the same pointer.
+  const char *Intern(const char *s, std::size_t length);
+  const char *Intern(const char *s) {
+    return Intern(s, std::strlen(s));
+  }
+  const char *Intern(const std::string &s) {
+    return Intern(s.data(), s.length());
+  }
+
+  // Number of distinct strings in the pool.
+  std::size_t size() const { return num_strings_; }
+
+ private:
+  struct Entry {
+    const char *data;
+    std::size_t length;
+    uint32_t hash;
+  };
+
+  char *Allocate(std::size_t size);
+  void Rehash(std::size_t capacity);
+
+ private:
+  std::vector<Entry> table_;
+  std::vector<char*> blocks_;
+  char *block_ptr_;
+  std::size_t block_space_;
+  std::size_t num_strings_;
+
+ private:
+  AMXPROF_DISALLOW_COPY_AND_ASSIGN(StringPool);
+};
+
+} // namespace amxprof
+
+#endif // !AMXPROF_STRING_POOL_H
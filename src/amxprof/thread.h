@@ -0,0 +1,60 @@
+// Copyright (c) 2015 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef AMXPROF_THREAD_H
+#define AMXPROF_THREAD_H
+
+#include "macros.h"
+
+namespace amxprof {
+
+class Thread {
+ public:
+  typedef void (*Function)(void *arg);
+
+  Thread();
+  ~Thread();
+
+  // Runs function(arg) in a new thread.
+  bool Start(Function function, void *arg);
+
+  // Waits for the thread to finish.
+  void Join();
+
+  bool is_started() const { return handle_ != 0; }
+
+  // Suspends the calling thread for at least the given time. Zero just
+  // gives up the rest of the time slice.
+  static void Sleep(long milliseconds);
+
+ private:
+  void *handle_;
+
+ private:
+  AMXPROF_DISALLOW_COPY_AND_ASSIGN(Thread);
+};
+
+} // namespace amxprof
+
+#endif // !AMXPROF_THREAD_H
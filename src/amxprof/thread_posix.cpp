@@ -0,0 +1,96 @@
+// Copyright (c) 2015 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <ctime>
+#include <pthread.h>
+#include <sched.h>
+#include "thread.h"
+
+namespace amxprof {
+
+namespace {
+
+struct ThreadHandle {
+  pthread_t thread;
+  Thread::Function function;
+  void *arg;
+};
+
+void *ThreadMain(void *arg) {
+  ThreadHandle *handle = static_cast<ThreadHandle*>(arg);
+  handle->function(handle->arg);
+  return 0;
+}
+
+} // anonymous namespace
+
+Thread::Thread()
+ : handle_(0)
+{
+}
+
+Thread::~Thread() {
+  Join();
+}
+
+bool Thread::Start(Function function, void *arg) {
+  if (handle_ != 0) {
+    return false;
+  }
+
+  ThreadHandle *handle = new ThreadHandle;
+  handle->function = function;
+  handle->arg = arg;
+
+  if (pthread_create(&handle->thread, 0, ThreadMain, handle) != 0) {
+    delete handle;
+    return false;
+  }
+
+  handle_ = handle;
+  return true;
+}
+
+void Thread::Join() {
+  if (handle_ != 0) {
+    ThreadHandle *handle = static_cast<ThreadHandle*>(handle_);
+    pthread_join(handle->thread, 0);
+    delete handle;
+    handle_ = 0;
+  }
+}
+
+// static
+void Thread::Sleep(long milliseconds) {
+  if (milliseconds <= 0) {
+    sched_yield();
+    return;
+  }
+  timespec duration;
+  duration.tv_sec = milliseconds / 1000;
+  duration.tv_nsec = (milliseconds % 1000) * 1000000L;
+  nanosleep(&duration, 0);
+}
+
+} // namespace amxprof
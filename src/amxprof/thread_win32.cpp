@@ -0,0 +1,90 @@
+// Copyright (c) 2015 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include "thread.h"
+
+namespace amxprof {
+
+namespace {
+
+struct ThreadStart {
+  Thread::Function function;
+  void *arg;
+};
+
+DWORD WINAPI ThreadMain(LPVOID arg) {
+  ThreadStart *start = static_cast<ThreadStart*>(arg);
+  Thread::Function function = start->function;
+  void *function_arg = start->arg;
+  delete start;
+  function(function_arg);
+  return 0;
+}
+
+} // anonymous namespace
+
+Thread::Thread()
+ : handle_(0)
+{
+}
+
+Thread::~Thread() {
+  Join();
+}
+
+bool Thread::Start(Function function, void *arg) {
+  if (handle_ != 0) {
+    return false;
+  }
+
+  ThreadStart *start = new ThreadStart;
+  start->function = function;
+  start->arg = arg;
+
+  HANDLE thread = CreateThread(0, 0, ThreadMain, start, 0, 0);
+  if (thread == 0) {
+    delete start;
+    return false;
+  }
+
+  handle_ = thread;
+  return true;
+}
+
+void Thread::Join() {
+  if (handle_ != 0) {
+    WaitForSingleObject(handle_, INFINITE);
+    CloseHandle(handle_);
+    handle_ = 0;
+  }
+}
+
+// static
+void Thread::Sleep(long milliseconds) {
+  ::Sleep(milliseconds > 0 ? static_cast<DWORD>(milliseconds) : 0);
+}
+
+} // namespace amxprof
@@ -0,0 +1,96 @@
+// Copyright (c) 2015 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <sstream>
+#include <amx/amx.h>
+#include "debuginfocache.h"
+#include "fileutils.h"
+
+DebugInfoCache::KeyToEntryMap DebugInfoCache::entries_;
+DebugInfoCache::DebugInfoToEntryMap DebugInfoCache::debug_info_to_entry_;
+
+// static
+std::string DebugInfoCache::MakeKey(const std::string &path) {
+  std::ostringstream key;
+  key << path << '\0'
+      << static_cast<long long>(fileutils::GetModificationTime(path)) << '\0'
+      << static_cast<unsigned long>(fileutils::GetFileSize(path));
+  return key.str();
+}
+
+// static
+const amxprof::DebugInfo *DebugInfoCache::Acquire(const std::string &path,
+                                                  int *error) {
+  std::string key = MakeKey(path);
+
+  KeyToEntryMap::iterator iterator = entries_.find(key);
+  if (iterator != entries_.end()) {
+    Entry *entry = iterator->second;
+    entry->ref_count++;
+    if (error != 0) {
+      *error = AMX_ERR_NONE;
+    }
+    return entry->debug_info;
+  }
+
+  amxprof::DebugInfo *debug_info = new amxprof::DebugInfo;
+  if (!debug_info->Load(path)) {
+    if (error != 0) {
+      *error = debug_info->last_error();
+    }
+    delete debug_info;
+    return 0;
+  }
+
+  Entry *entry = new Entry;
+  entry->key = key;
+  entry->debug_info = debug_info;
+  entry->ref_count = 1;
+  entries_.insert(std::make_pair(key, entry));
+  debug_info_to_entry_.insert(std::make_pair(debug_info, entry));
+
+  if (error != 0) {
+    *error = AMX_ERR_NONE;
+  }
+  return debug_info;
+}
+
+// static
+void DebugInfoCache::Release(const amxprof::DebugInfo *debug_info) {
+  DebugInfoToEntryMap::iterator iterator =
+    debug_info_to_entry_.find(debug_info);
+  if (iterator == debug_info_to_entry_.end()) {
+    return;
+  }
+
+  Entry *entry = iterator->second;
+  if (--entry->ref_count > 0) {
+    return;
+  }
+
+  debug_info_to_entry_.erase(iterator);
+  entries_.erase(entry->key);
+  delete entry->debug_info;
+  delete entry;
+}
@@ -0,0 +1,66 @@
+// Copyright (c) 2015 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef DEBUGINFOCACHE_H
+#define DEBUGINFOCACHE_H
+
+#include <cstddef>
+#include <ctime>
+#include <map>
+#include <string>
+#include <amxprof/debug_info.h>
+
+// Keeps one loaded DebugInfo per AMX file for the whole process so that
+// scripts that are loaded several times, or reloaded without changes,
+// share the same symbol tables instead of parsing them again.
+//
+// Entries are keyed by path, modification time and size: when the file
+// changes on disk a new entry is created and the old one lives on until
+// its last user releases it.
+class DebugInfoCache {
+ public:
+  // Returns the debug info for the given file, loading it if necessary.
+  // On failure returns 0 and stores the AMX error code in error.
+  static const amxprof::DebugInfo *Acquire(const std::string &path,
+                                           int *error = 0);
+  static void Release(const amxprof::DebugInfo *debug_info);
+
+ private:
+  struct Entry {
+    std::string key;
+    amxprof::DebugInfo *debug_info;
+    int ref_count;
+  };
+
+  static std::string MakeKey(const std::string &path);
+
+ private:
+  typedef std::map<std::string, Entry*> KeyToEntryMap;
+  static KeyToEntryMap entries_;
+
+  typedef std::map<const amxprof::DebugInfo*, Entry*> DebugInfoToEntryMap;
+  static DebugInfoToEntryMap debug_info_to_entry_;
+};
+
+#endif // !DEBUGINFOCACHE_H
@@ -83,6 +83,26 @@ std::time_t GetModificationTime(const std::string &path) {
   return 0;
 }
 
+std::size_t GetFileSize(const std::string &path) {
+  struct stat attrib;
+  if (stat(path.c_str(), &attrib) == 0) {
+    return static_cast<std::size_t>(attrib.st_size);
+  }
+  return 0;
+}
+
+bool GetModificationTimeAndSize(const std::string &path,
+                                std::time_t &mtime,
+                                std::size_t &size) {
+  struct stat attrib;
+  if (stat(path.c_str(), &attrib) != 0) {
+    return false;
+  }
+  mtime = attrib.st_mtime;
+  size = static_cast<std::size_t>(attrib.st_size);
+  return true;
+}
+
 std::string ToUnixPath(std::string path) {
   std::replace(path.begin(), path.end(), '\\', '/');
   return path;
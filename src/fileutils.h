@@ -25,6 +25,7 @@
 #ifndef FILEUTILS_H
 #define FILEUTILS_H
 
+#include <cstddef>
 #include <ctime>
 #include <string>
 #include <vector>
@@ -44,6 +45,13 @@ std::string GetFileExtension(const std::string &path);
 const char *GetFileExtensionPtr(const char *path);
 
 std::time_t GetModificationTime(const std::string &path);
+std::size_t GetFileSize(const std::string &path);
+
+// Same as the two above but with a single stat() call. Returns false if
+// the file doesn't exist.
+bool GetModificationTimeAndSize(const std::string &path,
+                                std::time_t &mtime,
+                                std::size_t &size);
 
 void GetDirectoryFiles(const std::string &directory,
                        const std::string &pattern,
@@ -98,17 +98,48 @@ AMXPathFinder amx_path_finder;
   }
 #endif
 
+template<int Features>
 int AMXAPI amx_Debug_Profiler(AMX *amx) {
   ProfilerHandler *profiler = ProfilerHandler::GetHandler(amx);
-  return profiler->Debug();
+  return profiler->Debug<Features>();
 }
 
+template<int Features>
 int AMXAPI amx_Callback_Profiler(AMX *amx,
-                                        cell index,
-                                        cell *result,
-                                        cell *params) {
+                                 cell index,
+                                 cell *result,
+                                 cell *params) {
   ProfilerHandler *profiler = ProfilerHandler::GetHandler(amx);
-  return profiler->Callback(index, result, params);
+  return profiler->Callback<Features>(index, result, params);
+}
+
+template<int Features>
+void InstallHooks(AMX *amx) {
+  const int kNonNativeFeatures =
+    Features & amxprof::Profiler::NON_NATIVE_FEATURES;
+  amx_SetDebugHook(amx, amx_Debug_Profiler<kNonNativeFeatures>);
+  amx_SetCallback(amx, amx_Callback_Profiler<Features>);
+}
+
+// Picks the hooks compiled for the features that the profiler is going to
+// use, so that they don't have to check for them on every call. This only
+// runs once per script, so it simply tries every combination in turn.
+template<int Features>
+void InstallHooks(AMX *amx, int features) {
+  if (features == Features) {
+    InstallHooks<Features>(amx);
+  } else {
+    InstallHooks<Features - 1>(amx, features);
+  }
+}
+
+template<>
+void InstallHooks<-1>(AMX *, int) {
+}
+
+void InstallHooks(AMX *amx, int features) {
+  InstallHooks<amxprof::Profiler::NUM_FEATURE_COMBINATIONS - 1>(amx,
+                                                                features);
 }
 
 int AMXAPI amx_Exec_Profiler(AMX *amx, cell *retval, int index) {
@@ -152,6 +183,7 @@ PLUGIN_EXPORT bool PLUGIN_CALL Load(void **ppData) {
     fopen_hook.Install((void*)fopen, (void*)FopenHook);
   #endif
 
+  amx_path_finder.set_cache_file("plugins/profiler.cache");
   amx_path_finder.AddSearchPath("gamemodes");
   amx_path_finder.AddSearchPath("filterscripts");
 
@@ -184,8 +216,7 @@ PLUGIN_EXPORT int PLUGIN_CALL AmxLoad(AMX *amx) {
   if (profiler->GetState() > PROFILER_DISABLED) {
     profiler->Start();
 
-    amx_SetDebugHook(amx, amx_Debug_Profiler);
-    amx_SetCallback(amx, amx_Callback_Profiler);
+    InstallHooks(amx, profiler->GetProfilerFeatures());
 
     // This should stop the VM from replacing SYSREQ.C instructions with
     // SYSREQ.D and allow us to profile native functions.
@@ -25,12 +25,15 @@
 #include <algorithm>
 #include <cassert>
 #include <cstdarg>
+#include <cstdlib>
 #include <exception>
 #include <fstream>
 #include <iterator>
 #include <sstream>
 #include <string>
+#include <vector>
 #include <amx/amxaux.h>
+#include <amxprof/amx_utils.h>
 #include <amxprof/call_graph_writer_dot.h>
 #include <amxprof/function.h>
 #include <amxprof/function_statistics.h>
@@ -38,6 +41,7 @@
 #include <amxprof/statistics_writer_json.h>
 #include <amxprof/statistics_writer_text.h>
 #include "amxpathfinder.h"
+#include "debuginfocache.h"
 #include "fileutils.h"
 #include "logprintf.h"
 #include "profilerhandler.h"
@@ -60,6 +64,28 @@ bool call_graph =
     server_cfg.GetValueWithDefault("profiler_callgraph", false);
 std::string call_graph_format =
     server_cfg.GetValueWithDefault("profiler_callgraphformat", "dot");
+bool record_events =
+    server_cfg.GetValueWithDefault("profiler_recordevents", false);
+bool async =
+    server_cfg.GetValueWithDefault("profiler_async", false);
+long sample_interval =
+    server_cfg.GetValueWithDefault("profiler_sampleinterval", 0L);
+long sample_min_calls =
+    server_cfg.GetValueWithDefault("profiler_samplemincalls", 10000L);
+long sample_max_time =
+    server_cfg.GetValueWithDefault("profiler_samplemaxtime", 1000L);
+double max_overhead_percent =
+    server_cfg.GetValueWithDefault("profiler_max_overhead_percent", 0.0);
+bool native_payload =
+    server_cfg.GetValueWithDefault("profiler_nativepayload", false);
+bool redundant_natives =
+    server_cfg.GetValueWithDefault("profiler_redundantnatives", false);
+std::vector<std::string> native_args =
+    server_cfg.GetValues<std::string>("profiler_nativeargs");
+bool memory =
+    server_cfg.GetValueWithDefault("profiler_memory", false);
+bool cpu_time =
+    server_cfg.GetValueWithDefault("profiler_cputime", false);
 
 namespace old {
 
@@ -94,6 +120,21 @@ void PrintException(const std::exception &e) {
   Printf("Error: %s", e.what());
 }
 
+// Sampling settings used when profiling is throttled to the sampled
+// level. They are much more aggressive than the defaults.
+const long kThrottledSampleInterval = 16;
+const long kThrottledSampleMinCalls = 100;
+const amxprof::Microseconds kThrottledSampleMaxTime(100);
+
+const int kCallGraph = amxprof::Profiler::FEATURE_CALL_GRAPH;
+const int kRecordEvents = amxprof::Profiler::FEATURE_RECORD_EVENTS;
+const int kMemory = amxprof::Profiler::FEATURE_MEMORY;
+const int kCpuTime = amxprof::Profiler::FEATURE_CPU_TIME;
+const int kNativePayload = amxprof::Profiler::FEATURE_NATIVE_PAYLOAD;
+const int kRedundantNatives = amxprof::Profiler::FEATURE_REDUNDANT_NATIVES;
+const int kNativeArgumentValues =
+  amxprof::Profiler::FEATURE_NATIVE_ARGUMENT_VALUES;
+
 bool IsCallGraphEnabled() {
   return cfg::call_graph || cfg::old::call_graph;
 }
@@ -149,12 +190,30 @@ ProfilerHandler::ProfilerHandler(AMX *amx)
    prev_debug_(amx->debug),
    prev_callback_(amx->callback),
    profiler_(amx, IsCallGraphEnabled()),
+   async_profiler_(amx, &profiler_),
+   overhead_throttle_(cfg::max_overhead_percent),
+   debug_info_(0),
    state_(PROFILER_DISABLED)
 {
+  profiler_.EnableSampling(cfg::sample_interval,
+                           cfg::sample_min_calls,
+                           amxprof::Nanoseconds(cfg::sample_max_time));
+  profiler_.set_native_payload_enabled(cfg::native_payload);
+  profiler_.set_redundant_calls_enabled(cfg::redundant_natives);
+  profiler_.set_memory_tracking_enabled(cfg::memory && !cfg::async);
+  profiler_.set_cpu_time_enabled(cfg::cpu_time && !cfg::async);
+}
+
+ProfilerHandler::~ProfilerHandler() {
+  if (debug_info_ != 0 && debug_info_ != &sidecar_debug_info_) {
+    DebugInfoCache::Release(debug_info_);
+  }
 }
 
 int ProfilerHandler::Load() {
-  amx_path_ = fileutils::ToUnixPath(amx_path_finder_->Find(amx()));
+  std::vector<std::string> other_paths;
+  amx_path_ = fileutils::ToUnixPath(amx_path_finder_->Find(amx(),
+                                                            &other_paths));
   amx_name_ = fileutils::GetDirectory(amx_path_)
             + "/"
             + fileutils::GetBaseName(amx_path_);
@@ -162,6 +221,14 @@ int ProfilerHandler::Load() {
   if (amx_path_.empty()) {
     Printf("Could not find AMX file (try setting AMX_PATH?)");
   }
+  // Identical headers usually mean copies of the same script, but the
+  // debug info could still come from the wrong one.
+  for (std::vector<std::string>::const_iterator iterator =
+         other_paths.begin();
+       iterator != other_paths.end(); ++iterator) {
+    Printf("%s looks the same as %s, assuming the latter",
+           fileutils::ToUnixPath(*iterator).c_str(), amx_path_.c_str());
+  }
   if (ShouldBeProfiled(amx_path_)) {
     Attach();
   }
@@ -172,13 +239,13 @@ int ProfilerHandler::Unload() {
   return AMX_ERR_NONE;
 }
 
-int ProfilerHandler::Debug() {
+template<int Features>
+int ProfilerHandler::Debug() AMXPROF_NOEXCEPT_DEF {
   if (state_ == PROFILER_STARTED) {
-    try {
-      return profiler_.DebugHook(prev_debug_);
-    } catch (const std::exception &e) {
-      PrintException(e);
+    if (async_profiler_.is_started()) {
+      return async_profiler_.DebugHook(prev_debug_);
     }
+    return profiler_.DebugHook<Features>(prev_debug_);
   }
   if (prev_debug_ != 0) {
     return prev_debug_(amx());
@@ -186,19 +253,23 @@ int ProfilerHandler::Debug() {
   return AMX_ERR_NONE;
 }
 
-int ProfilerHandler::Callback(cell index, cell *result, cell *params) {
+template<int Features>
+int ProfilerHandler::Callback(cell index,
+                              cell *result,
+                              cell *params) AMXPROF_NOEXCEPT_DEF {
   if (state_ == PROFILER_STARTED) {
-    try {
-      return profiler_.CallbackHook(index, result, params, prev_callback_);
-    } catch (const std::exception &e) {
-      PrintException(e);
+    if (async_profiler_.is_started()) {
+      return async_profiler_.CallbackHook(index, result, params,
+                                          prev_callback_);
     }
+    return profiler_.CallbackHook<Features>(index, result, params,
+                                            prev_callback_);
   }
   return prev_callback_(amx(), index, result, params);
 }
 
 int ProfilerHandler::Exec(cell *retval, int index) {
-  if (profiler_.call_stack()->is_empty()) {
+  if (IsCallStackEmpty()) {
     switch (state_) {
       case PROFILER_ATTACHING:
         if (!Attach()) {
@@ -212,10 +283,16 @@ int ProfilerHandler::Exec(cell *retval, int index) {
   }
   if (state_ == PROFILER_STARTED) {
     try {
-      int error = profiler_.ExecHook(retval, index, amx_Exec);
-      if (state_ == PROFILER_STOPPING
-          && profiler_.call_stack()->is_empty()) {
-        CompleteStop();
+      int error = async_profiler_.is_started()
+        ? async_profiler_.ExecHook(retval, index, amx_Exec)
+        : profiler_.ExecHook(retval, index, amx_Exec);
+      if (IsCallStackEmpty()) {
+        ReportClockErrors();
+        if (state_ == PROFILER_STOPPING) {
+          CompleteStop();
+        } else {
+          UpdateOverheadThrottle();
+        }
       }
       return error;
     } catch (const std::exception &e) {
@@ -225,10 +302,89 @@ int ProfilerHandler::Exec(cell *retval, int index) {
   return amx_Exec(amx(), retval, index);
 }
 
+void ProfilerHandler::ReportClockErrors() {
+  // The hooks can't throw, so clock errors are only reported here.
+  try {
+    amxprof::Clock::ThrowError();
+  } catch (const std::exception &e) {
+    PrintException(e);
+  }
+}
+
+void ProfilerHandler::UpdateOverheadThrottle() {
+  // In async mode most of the work is done on another thread, and that
+  // is not measured.
+  if (async_profiler_.is_started()) {
+    return;
+  }
+  amxprof::OverheadThrottle::Level old_level = overhead_throttle_.level();
+  if (!overhead_throttle_.Update(&profiler_, amxprof::Clock::Now())) {
+    return;
+  }
+
+  amxprof::OverheadThrottle::Level level = overhead_throttle_.level();
+  if (level < old_level) {
+    // Functions sampled at a lower level would otherwise keep its
+    // interval.
+    profiler_.ResetSampling();
+  }
+  switch (level) {
+    case amxprof::OverheadThrottle::LEVEL_FULL:
+      profiler_.set_normal_functions_enabled(true);
+      profiler_.EnableSampling(cfg::sample_interval,
+                               cfg::sample_min_calls,
+                               amxprof::Nanoseconds(cfg::sample_max_time));
+      break;
+    case amxprof::OverheadThrottle::LEVEL_SAMPLED:
+      profiler_.set_normal_functions_enabled(true);
+      profiler_.EnableSampling(kThrottledSampleInterval,
+                               kThrottledSampleMinCalls,
+                               kThrottledSampleMaxTime);
+      break;
+    case amxprof::OverheadThrottle::LEVEL_PUBLICS_AND_NATIVES:
+      profiler_.set_normal_functions_enabled(false);
+      break;
+  }
+
+  Printf("Profiling overhead is %.1f%% (limit is %.1f%%), switching to %s "
+         "profiling",
+         overhead_throttle_.overhead_percent(),
+         overhead_throttle_.max_overhead_percent(),
+         amxprof::OverheadThrottle::GetLevelString(level));
+}
+
 ProfilerState ProfilerHandler::GetState() const {
   return state_;
 }
 
+int ProfilerHandler::GetProfilerFeatures() const {
+  int features = 0;
+  if (IsCallGraphEnabled()) {
+    features |= kCallGraph;
+  }
+  // The recorder may still fail to open, the profiler checks for that.
+  if (cfg::record_events && !cfg::async) {
+    features |= kRecordEvents;
+  }
+  if (cfg::memory && !cfg::async) {
+    features |= kMemory;
+  }
+  if (cfg::cpu_time && !cfg::async) {
+    features |= kCpuTime;
+  }
+  if (cfg::native_payload) {
+    features |= kNativePayload;
+  }
+  if (cfg::redundant_natives) {
+    features |= kRedundantNatives;
+  }
+  // Whether any of them can be tracked is only known after attaching.
+  if (!cfg::native_args.empty()) {
+    features |= kNativeArgumentValues;
+  }
+  return features;
+}
+
 bool ProfilerHandler::Attach() {
   try {
     if (amx_path_.empty()) {
@@ -238,21 +394,45 @@ bool ProfilerHandler::Attach() {
       return false;
     }
 
-    if (amxprof::HasDebugInfo(amx())) {
-      if (debug_info_.Load(amx_path_)) {
-        profiler_.set_debug_info(&debug_info_);
-      } else {
-        Printf("Error loading debug info: %s",
-                aux_StrError(debug_info_.last_error()));
-      }
-    }
+    LoadDebugInfo();
 
-    if (debug_info_.is_loaded()) {
+    if (debug_info_ != 0) {
       Printf("Attached profiler to %s", amx_name_.c_str());
     } else {
       Printf("Attached profiler to %s (no debug info)", amx_name_.c_str());
     }
 
+    profiler_.Allocate();
+    profiler_.CalibrateOverhead();
+    Printf("Estimated profiling overhead per call: %.0f ns",
+           profiler_.call_overhead().count());
+
+    // Each value is <native>:<argument>, natives that the script doesn't
+    // use are skipped. The same native can be listed several times with
+    // different arguments.
+    for (std::vector<std::string>::const_iterator iterator =
+           cfg::native_args.begin();
+         iterator != cfg::native_args.end(); ++iterator) {
+      std::string::size_type colon = iterator->find(':');
+      std::string native = iterator->substr(0, colon);
+      int position = 1;
+      if (colon != std::string::npos) {
+        position = std::atoi(iterator->c_str() + colon + 1);
+      }
+      if (amxprof::FindNative(amx(), native.c_str()) < 0) {
+        continue;
+      }
+      if (profiler_.TrackNativeArgument(native.c_str(), position)) {
+        Printf("Tracking values of argument %d of %s", position,
+               native.c_str());
+      } else {
+        Printf("Not tracking argument %d of %s: it is invalid, listed more "
+               "than once or over the limit of %d arguments per native",
+               position, native.c_str(),
+               amxprof::NativeArgumentValues::kMaxArgumentsPerNative);
+      }
+    }
+
     state_ = PROFILER_ATTACHED;
     return true;
   }
@@ -262,6 +442,48 @@ bool ProfilerHandler::Attach() {
   return false;
 }
 
+void ProfilerHandler::LoadDebugInfo() {
+  int error;
+
+  if (amxprof::HasDebugInfo(amx())) {
+    debug_info_ = DebugInfoCache::Acquire(amx_path_, &error);
+    if (debug_info_ != 0) {
+      profiler_.set_debug_info(debug_info_);
+    } else {
+      Printf("Error loading debug info: %s", aux_StrError(error));
+    }
+    return;
+  }
+
+  // Scripts compiled without debug info can still be symbolized from a
+  // build of the same source that has it, e.g. gamemodes/foo.amx.dbg. Its
+  // addresses are moved onto the script's code, which doesn't have to have
+  // the same BREAK instructions.
+  std::string dbg_path = amx_path_ + ".dbg";
+  if (!sidecar_debug_info_.Load(dbg_path)) {
+    error = sidecar_debug_info_.last_error();
+    if (error != AMX_ERR_NOTFOUND) {
+      Printf("Error loading debug info from %s: %s",
+             dbg_path.c_str(), aux_StrError(error));
+    }
+    return;
+  }
+
+  uint32_t code_hash;
+  std::vector<amxprof::Address> breaks;
+  if (!amxprof::GetCodeHash(amx_path_, &code_hash, &breaks)
+      || code_hash != sidecar_debug_info_.code_hash()) {
+    Printf("Debug info in %s does not match %s, ignoring",
+           dbg_path.c_str(), amx_path_.c_str());
+    sidecar_debug_info_.Unload();
+    return;
+  }
+
+  sidecar_debug_info_.MoveBreaks(breaks);
+  debug_info_ = &sidecar_debug_info_;
+  profiler_.set_debug_info(debug_info_);
+}
+
 bool ProfilerHandler::Start() {
   if (state_ < PROFILER_ATTACHED) {
     state_ = PROFILER_ATTACHING;
@@ -274,7 +496,30 @@ bool ProfilerHandler::Start() {
   return false;
 }
 
+bool ProfilerHandler::IsCallStackEmpty() const {
+  if (async_profiler_.is_started()) {
+    return async_profiler_.is_call_stack_empty();
+  }
+  return profiler_.call_stack()->is_empty();
+}
+
 void ProfilerHandler::CompleteStart() {
+  if (cfg::async) {
+    if (cfg::record_events) {
+      Printf("Event recording is not supported in async mode");
+    }
+    if (!async_profiler_.Start()) {
+      Printf("Could not start aggregator thread, profiling synchronously");
+    }
+  } else if (cfg::record_events) {
+    std::string events_filename = amx_name_ + "-events.bin";
+    if (event_recorder_.Open(events_filename)) {
+      Printf("Recording events to %s", events_filename.c_str());
+      profiler_.set_event_recorder(&event_recorder_);
+    } else {
+      Printf("Error opening '%s' for writing", events_filename.c_str());
+    }
+  }
   Printf("Started profiling %s", amx_name_.c_str());
   state_ = PROFILER_STARTED;
 }
@@ -288,17 +533,33 @@ bool ProfilerHandler::Stop() {
 }
 
 void ProfilerHandler::CompleteStop() {
+  if (async_profiler_.is_started()) {
+    async_profiler_.Stop();
+    if (async_profiler_.num_stalls() > 0) {
+      Printf("Aggregator thread fell behind %lu times",
+             async_profiler_.num_stalls());
+    }
+  }
+  profiler_.set_event_recorder(0);
+  event_recorder_.Close();
   Printf("Stopped profiling %s", amx_name_.c_str());
   state_ = PROFILER_STOPPED;
 }
 
-bool ProfilerHandler::Dump() const {
+bool ProfilerHandler::Dump() {
   try {
     if (state_ < PROFILER_ATTACHED) {
       return false;
     }
 
     Printf("Dumping profiling statistics for %s", amx_name_.c_str());
+    ReportClockErrors();
+
+    // Dump() is called from the AMX thread, so no new events can come in
+    // while it's running.
+    async_profiler_.Flush();
+
+    profiler_.SymbolizeFunctions();
 
     std::vector<amxprof::FunctionStatistics*> fn_stats;
     profiler_.stats()->GetStatistics(fn_stats);
@@ -358,6 +619,9 @@ bool ProfilerHandler::Dump() const {
         writer->set_script_name(amx_path_);
         writer->set_print_date(true);
         writer->set_print_run_time(true);
+        writer->set_print_compensated_times(true);
+        writer->set_print_memory_usage(profiler_.memory_tracking_enabled());
+        writer->set_print_cpu_time(profiler_.cpu_time_enabled());
         writer->Write(profiler_.stats());
         delete writer;
       }
@@ -408,3 +672,16 @@ bool ProfilerHandler::Dump() const {
   }
   return false;
 }
+
+// See InstallHooks() in plugin.cpp.
+#define INSTANTIATE_DEBUG_HOOK(Features) \
+  template int ProfilerHandler::Debug<Features>() AMXPROF_NOEXCEPT_DEF;
+#define INSTANTIATE_CALLBACK_HOOK(Features) \
+  template int ProfilerHandler::Callback<Features>(cell, cell*, cell*) \
+    AMXPROF_NOEXCEPT_DEF;
+
+AMXPROF_FOR_EACH_NON_NATIVE_FEATURES(INSTANTIATE_DEBUG_HOOK)
+AMXPROF_FOR_EACH_FEATURES(INSTANTIATE_CALLBACK_HOOK)
+
+#undef INSTANTIATE_DEBUG_HOOK
+#undef INSTANTIATE_CALLBACK_HOOK
@@ -26,7 +26,10 @@
 #define PROFILERHANDLER_H
 
 #include <configreader.h>
+#include <amxprof/async_profiler.h>
 #include <amxprof/debug_info.h>
+#include <amxprof/event_recorder.h>
+#include <amxprof/overhead_throttle.h>
 #include <amxprof/profiler.h>
 #include "amxhandler.h"
 
@@ -47,6 +50,9 @@ class AMXPathFinder;
 class ProfilerHandler : public AMXHandler<ProfilerHandler> {
  friend class AMXHandler<ProfilerHandler>;
 
+ public:
+  static const long kUserDataTag = AMX_USERTAG('P', 'R', 'O', 'F');
+
  public:
   void set_amx_path_finder(AMXPathFinder *finder) {
     amx_path_finder_ = finder;
@@ -55,23 +61,39 @@ class ProfilerHandler : public AMXHandler<ProfilerHandler> {
   int Load();
   int Unload();
 
-  int Debug();
-  int Callback(cell index, cell *result, cell *params);
+  // Debug() and Callback() are compiled for each combination of profiler
+  // features, see amxprof::Profiler::Feature and GetProfilerFeatures().
+  // Debug() only needs the non-native ones.
+  template<int Features>
+  int Debug() AMXPROF_NOEXCEPT;
+  template<int Features>
+  int Callback(cell index, cell *result, cell *params) AMXPROF_NOEXCEPT;
   int Exec(cell *retval, int index);
 
  public:
   ProfilerState GetState() const;
+
+  // The profiler features that can be used with this script. They don't
+  // change after the handler is created.
+  int GetProfilerFeatures() const;
   bool Attach();
   bool Start();
   bool Stop();
-  bool Dump() const;
+  bool Dump();
 
  private:
   ProfilerHandler(AMX *amx);
+  ~ProfilerHandler();
+
+  void LoadDebugInfo();
+  bool IsCallStackEmpty() const;
 
   void CompleteStart();
   void CompleteStop();
 
+  void ReportClockErrors();
+  void UpdateOverheadThrottle();
+
  private:
   AMXPathFinder *amx_path_finder_;
   std::string amx_path_;
@@ -79,7 +101,13 @@ class ProfilerHandler : public AMXHandler<ProfilerHandler> {
   AMX_DEBUG prev_debug_;
   AMX_CALLBACK prev_callback_;
   amxprof::Profiler profiler_;
-  amxprof::DebugInfo debug_info_;
+  amxprof::AsyncProfiler async_profiler_;
+  amxprof::OverheadThrottle overhead_throttle_;
+  amxprof::EventRecorder event_recorder_;
+  const amxprof::DebugInfo *debug_info_;
+  // Debug info from a .dbg file, not shared through DebugInfoCache because
+  // its addresses are moved onto this script's code.
+  amxprof::DebugInfo sidecar_debug_info_;
   ProfilerState state_;
 };
 